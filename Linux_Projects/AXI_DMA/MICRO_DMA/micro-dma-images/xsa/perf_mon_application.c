@@ -5,15 +5,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <stdint.h>
 #include <inttypes.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "perf_mon_functions.h"
 
 #include "flc_reg_rw.h"
 #include "flc_dma_to_device.c"
 #include "flc_dma_from_device.c"
+#include "perf_mon_stats.c"
 
 #define FLC1_ENABLED 1
 
@@ -51,68 +58,681 @@ int output_wr_count = 1;
 #define S2MM_DMA_CONTROL_OFFSET 		0x40030
 #define S2MM_CURRENT_DES_POINTER_OFFSET 	0x40038
 #define S2MM_TAIL_DES_POINTER_OFFSET    	0x40040
+//Miss mapper params
+#define TXNS_TEXT_OUTPUT 1	//also render txns_file.txt for the gui
+#define HITS_PER_GAP 100	//hit lines written between two misses
+#define MAX_MAPPER_THREADS 8
+#define MIN_MISSES_PER_THREAD 0x10000
+#define MISS_NUMBER_MASK 0x7fffffffffffffffULL
+#define MISS_DDR_MISS 0x8000000000000000ULL
+
+/* One row of txns_file.bin, carries the same fields as a line of txns_file.txt */
+struct txn_record {
+	uint64_t index;		//1 based position of the transaction in the trace
+	uint32_t address;
+	uint8_t ipm_hit;
+	uint8_t ddr_hit;
+	uint16_t reserved;
+};
+
+/*
+ * Everything the miss mapper keeps for one trace file. The live mode in main()
+ * uses a single context, the worker queue gives every file its own.
+ */
+struct map_ctx {
+	uint64_t file_ptr;		//trace transactions consumed so far
+	uint64_t ddr_hits;
+	uint64_t records;		//rows written to the txns files
+	struct flc_stats *stats;
+	const char *txt_name;
+	const char *bin_name;
+	long max_threads;
+	int quiet;			//no progress lines, used when several files map at once
+	uint64_t progress;		//misses mapped in the current call, updated by the mapper threads
+	int done;
+};
+
+/* Slice of the miss list handled by one mapper thread */
+struct mapper_chunk {
+	struct map_ctx *ctx;
+	const uint64_t *trace;
+	uint64_t trace_txns;
+	const uint64_t *misses;
+	uint64_t first_miss;
+	uint64_t last_miss;
+	uint64_t start_pos;
+	uint64_t end_pos;
+	uint64_t ddr_hits;
+	struct txn_record *rec;
+	uint64_t nrec;
+	uint64_t cap;
+	char *text;
+	size_t text_len;
+	int failed;
+};
+
+/* The stats see every transaction of the batch, not just the ones written to txns_file */
+struct stats_job {
+	struct flc_stats *stats;
+	const uint64_t *trace;
+	uint64_t trace_txns;
+	const uint64_t *misses;
+	uint64_t num_misses;
+	uint64_t start_pos;
+};
+
+struct flc_stats trace_stats;		//statistics of the trace file being replayed in live mode
+
+static double now_sec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int push_record(struct mapper_chunk *c, uint64_t index, uint64_t pkt, uint8_t ipm_hit, uint8_t ddr_hit)
+{
+	struct txn_record *r;
+	if(c->nrec == c->cap)
+	{
+		uint64_t cap = c->cap ? c->cap * 2 : 0x10000;
+		r = realloc(c->rec, cap * sizeof(*r));
+		if(r == NULL)
+			return -1;
+		c->rec = r;
+		c->cap = cap;
+	}
+	r = &c->rec[c->nrec++];
+	r->index = index;
+	r->address = (pkt >> 16) & 0xFFFFFFFF;
+	r->ipm_hit = ipm_hit;
+	r->ddr_hit = ddr_hit;
+	r->reserved = 0;
+	return 0;
+}
+
+/* Same as printf("0x%08lx") without going through the format parser */
+static char *put_hex(char *p, uint64_t v)
+{
+	static const char digits[] = "0123456789abcdef";
+	int n = 8;
+	while(n < 16 && (v >> (n * 4)) != 0)
+		n++;
+	*p++ = '0';
+	*p++ = 'x';
+	while(n-- > 0)
+		*p++ = digits[(v >> (n * 4)) & 0xF];
+	return p;
+}
+
+/* Text renderer, produces exactly the lines the old fprintf loop wrote */
+static size_t render_records(const struct txn_record *rec, uint64_t nrec, char *out)
+{
+	char *p = out;
+	for(uint64_t i = 0; i < nrec; i++)
+	{
+		p = put_hex(p, rec[i].index);
+		*p++ = ',';
+		p = put_hex(p, rec[i].address);
+		*p++ = ',';
+		*p++ = rec[i].ipm_hit ? 'y' : 'n';
+		*p++ = ',';
+		*p++ = rec[i].ddr_hit ? 'y' : 'n';
+		*p++ = '\n';
+	}
+	return p - out;
+}
+
+static void *map_chunk(void *arg)
+{
+	struct mapper_chunk *c = arg;
+	uint64_t pos = c->start_pos;
+	uint64_t miss_number, gap_end, reported = 0;
+	uint8_t ddr_hit;
+
+	for(uint64_t m = c->first_miss; m < c->last_miss; m++)
+	{
+		miss_number = c->misses[m] & MISS_NUMBER_MASK;
+		gap_end = miss_number < c->trace_txns ? miss_number : c->trace_txns;
+		//only the first hits of a gap are reported, the rest is skipped without touching the trace
+		for(uint64_t hits = 0; pos < gap_end; hits++)
+		{
+			if(hits == HITS_PER_GAP)
+			{
+				pos = gap_end;
+				break;
+			}
+			if(push_record(c, pos + 1, c->trace[pos], 1, 0))
+				goto fail;
+			pos++;
+		}
+		if(pos >= c->trace_txns)
+			break;
+		ddr_hit = (c->misses[m] & MISS_DDR_MISS) == 0;
+		if(push_record(c, pos + 1, c->trace[pos], 0, ddr_hit))
+			goto fail;
+		pos++;
+		c->ddr_hits += ddr_hit;
+		if(((m - c->first_miss) & 0xFFFF) == 0xFFFF)
+		{
+			__atomic_add_fetch(&c->ctx->progress, 0x10000, __ATOMIC_RELAXED);
+			reported += 0x10000;
+		}
+	}
+	c->end_pos = pos;
+	__atomic_add_fetch(&c->ctx->progress, (c->last_miss - c->first_miss) - reported, __ATOMIC_RELAXED);
+#if TXNS_TEXT_OUTPUT
+	//longest line is 0x + 16 digits + ,0x + 8 digits + ,y,n\n
+	c->text = malloc(c->nrec * 34 + 1);
+	if(c->text == NULL)
+		goto fail;
+	c->text_len = render_records(c->rec, c->nrec, c->text);
+#endif
+	__atomic_add_fetch(&c->ctx->done, 1, __ATOMIC_RELEASE);
+	return NULL;
+fail:
+	c->failed = 1;
+	c->end_pos = pos;
+	__atomic_add_fetch(&c->ctx->done, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+static void stats_feed_hits(struct flc_stats *st, const uint64_t *trace, uint64_t pos, uint64_t end)
+{
+	for(; pos < end; pos++)
+		stats_add(st, pos + 1, (trace[pos] >> 16) & 0xFFFFFFFF, 1, 0);
+}
+
+static void *stats_feed(void *arg)
+{
+	struct stats_job *j = arg;
+	uint64_t pos = j->start_pos, miss_number, gap_end;
+
+	for(uint64_t m = 0; m < j->num_misses; m++)
+	{
+		miss_number = j->misses[m] & MISS_NUMBER_MASK;
+		gap_end = miss_number < j->trace_txns ? miss_number : j->trace_txns;
+		if(pos < gap_end)
+		{
+			stats_feed_hits(j->stats, j->trace, pos, gap_end);
+			pos = gap_end;
+		}
+		if(pos >= j->trace_txns)
+			break;
+		stats_add(j->stats, pos + 1, (j->trace[pos] >> 16) & 0xFFFFFFFF, 0, (j->misses[m] & MISS_DDR_MISS) == 0);
+		pos++;
+	}
+	return NULL;
+}
+
+/* Maps a whole file read-only, an empty file gives *map == NULL. Returns -1 with errno set on failure */
+static int map_file(int fd, const void **map, size_t *size)
+{
+	struct stat st;
+	void *p;
+	*map = NULL;
+	if(fstat(fd, &st) < 0)
+		return -1;
+	*size = st.st_size;
+	if(*size == 0)
+		return 0;
+	p = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+	if(p == MAP_FAILED)
+		return -1;
+	*map = p;
+	return 0;
+}
+
+/*
+ * Maps the misses reported by the hardware back onto the trace. Both files are
+ * mmapped and the miss list is split across threads, each thread fills its own
+ * record buffer which is written out in order afterwards. Misses come in trace
+ * order, so a chunk starts right after the miss preceding it.
+ */
+int map_misses(struct map_ctx *ctx, FILE *trace_file, const char *missed_txns_bin)
+{
+	FILE *wr_file,*bin_file;
+	const uint64_t *trace = NULL,*misses = NULL;
+	size_t trace_size = 0, miss_size = 0;
+	int miss_fd, ret = 0, oom = 0;
+	long nthreads;
+	uint64_t num_misses, per_thread, records = 0;
+	struct mapper_chunk chunk[MAX_MAPPER_THREADS];
+	pthread_t tid[MAX_MAPPER_THREADS];
+	struct stats_job job;
+	pthread_t stats_tid = 0;
+	double start = now_sec(), last_print = start, secs;
+
+	if(trace_file==NULL)
+		return -1;
+	wr_file = TXNS_TEXT_OUTPUT ? fopen(ctx->txt_name,"a") : NULL;
+	if(TXNS_TEXT_OUTPUT && wr_file==NULL)
+		return -1;
+	bin_file = fopen(ctx->bin_name,"ab");
+	if(bin_file==NULL)
+	{
+		if(wr_file)
+			fclose(wr_file);
+		return -1;
+	}
+	miss_fd = open(missed_txns_bin, O_RDONLY);
+	if(miss_fd < 0)
+	{
+		if(wr_file)
+			fclose(wr_file);
+		fclose(bin_file);
+		return -1;
+	}
+	if(!ctx->quiet)
+		printf("The file pointer value %" PRIu64 "\n",ctx->file_ptr);
+
+	if(map_file(miss_fd, (const void **)&misses, &miss_size) < 0)
+	{
+		printf("miss mapper : could not map %s: %s\n", missed_txns_bin, strerror(errno));
+		ret = -1;
+		goto out;
+	}
+	if(map_file(fileno(trace_file), (const void **)&trace, &trace_size) < 0)
+	{
+		printf("miss mapper : could not map the trace file: %s\n", strerror(errno));
+		ret = -1;
+		goto out;
+	}
+	//an empty miss list or trace is not an error, there is just nothing to map
+	num_misses = miss_size / sizeof(uint64_t);
+	if(misses == NULL || trace == NULL || num_misses == 0)
+		goto out;
+
+	nthreads = ctx->max_threads;
+	if(nthreads > MAX_MAPPER_THREADS)
+		nthreads = MAX_MAPPER_THREADS;
+	if((uint64_t)nthreads > num_misses / MIN_MISSES_PER_THREAD)
+		nthreads = num_misses / MIN_MISSES_PER_THREAD;
+	if(nthreads < 1)
+		nthreads = 1;
+	per_thread = (num_misses + nthreads - 1) / nthreads;
+
+	//the stats walk the whole batch in order on their own thread next to the mappers
+	if(ctx->stats)
+	{
+		job.stats = ctx->stats;
+		job.trace = trace;
+		job.trace_txns = trace_size / sizeof(uint64_t);
+		job.misses = misses;
+		job.num_misses = num_misses;
+		job.start_pos = ctx->file_ptr;
+		if(pthread_create(&stats_tid, NULL, stats_feed, &job) != 0)
+		{
+			stats_tid = 0;
+			stats_feed(&job);
+		}
+	}
+
+	ctx->progress = 0;
+	ctx->done = 0;
+	for(long t = 0; t < nthreads; t++)
+	{
+		struct mapper_chunk *c = &chunk[t];
+		memset(c, 0, sizeof(*c));
+		c->ctx = ctx;
+		c->trace = trace;
+		c->trace_txns = trace_size / sizeof(uint64_t);
+		c->misses = misses;
+		c->first_miss = t * per_thread;
+		c->last_miss = c->first_miss + per_thread < num_misses ? c->first_miss + per_thread : num_misses;
+		c->start_pos = ctx->file_ptr;
+		if(t > 0 && ((misses[c->first_miss - 1] & MISS_NUMBER_MASK) + 1) > ctx->file_ptr)
+			c->start_pos = (misses[c->first_miss - 1] & MISS_NUMBER_MASK) + 1;
+		if(pthread_create(&tid[t], NULL, map_chunk, c) != 0)
+		{
+			tid[t] = 0;
+			map_chunk(c);
+		}
+	}
+	//progress once a second while the workers run
+	while(__atomic_load_n(&ctx->done, __ATOMIC_ACQUIRE) < nthreads)
+	{
+		usleep(10000);
+		if(!ctx->quiet && now_sec() - last_print >= 1.0)
+		{
+			last_print = now_sec();
+			printf("miss mapper : %.2f\n", (double)__atomic_load_n(&ctx->progress, __ATOMIC_RELAXED) / num_misses * 100);
+		}
+	}
+	for(long t = 0; t < nthreads; t++)
+	{
+		struct mapper_chunk *c = &chunk[t];
+		if(tid[t])
+			pthread_join(tid[t], NULL);
+		if(c->failed && !oom)
+		{
+			printf("miss mapper : out of memory in chunk %ld\n", t);
+			oom = 1;
+		}
+		//records after a failed chunk would leave a hole in the output, write none of them
+		if(!oom)
+		{
+			fwrite(c->rec, sizeof(*c->rec), c->nrec, bin_file);
+			if(wr_file)
+				fwrite(c->text, 1, c->text_len, wr_file);
+			records += c->nrec;
+			ctx->ddr_hits += c->ddr_hits;
+		}
+		free(c->rec);
+		free(c->text);
+	}
+	if(stats_tid)
+		pthread_join(stats_tid, NULL);
+	if(oom)
+	{
+		ctx->records += records;
+		ret = -1;
+		goto out;
+	}
+	ctx->file_ptr = chunk[nthreads - 1].end_pos;
+	if(ctx->file_ptr > trace_size / sizeof(uint64_t))
+		ctx->file_ptr = trace_size / sizeof(uint64_t);
+	ctx->records += records;
+
+	secs = now_sec() - start;
+	if(!ctx->quiet)
+		printf("miss mapper : %" PRIu64 " misses, %" PRIu64 " records, %ld threads, %.3f s (%.2f M misses/s)\n",
+			num_misses, records, nthreads, secs, secs > 0 ? num_misses / secs / 1e6 : 0.0);
+out:
+	if(trace)
+		munmap((void *)trace, trace_size);
+	if(misses)
+		munmap((void *)misses, miss_size);
+	close(miss_fd);
+	if(wr_file)
+	{
+		fflush(wr_file);
+		fclose(wr_file);
+	}
+	fclose(bin_file);
+	if(oom)
+		errno = ENOMEM;
+	return ret;
+}
+
+/* Live mode entry point, keeps the globals main() reads in step with the context */
 void miss_mapper(FILE *trace_file,char *missed_txns_bin)
 {
-        int fdw,size;
-        FILE *fdr,*wr_file,*rd_file,*rw_file,*miss_file;
-        uint64_t pkt,access_size,access_type_tmp,access_type,address_offset;
-        fdr = trace_file;
-        wr_file = fopen("txns_file.txt","a");
-	miss_file= fopen(missed_txns_bin, "rb");
-        if(fdr==NULL)
-        {
-                printf("\nCould not open the file");
-                exit(1);
-        }
-        if(wr_file==NULL)
-        {
-                printf("\nCould not open the file");
-                exit(1);
-        }
-        if(miss_file==NULL)
-        {
-                printf("\nCould not open the file");
-                exit(1);
-        }
-	uint64_t miss_number = 0;
-	uint64_t serial_number = 0;
-	uint32_t hit_count = 0;
-	printf("The file pointer value %d\n",file_ptr);
-        while(fread(&serial_number,sizeof(uint64_t),1,miss_file) != 0)
+	static struct map_ctx live = {
+		.stats = &trace_stats,
+		.txt_name = "txns_file.txt",
+		.bin_name = "txns_file.bin",
+	};
+	uint64_t ddr_hits = live.ddr_hits, records = live.records;
+
+	live.file_ptr = file_ptr;
+	live.max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if(map_misses(&live, trace_file, missed_txns_bin) < 0)
+	{
+		printf("\nCould not map the missed transactions\n");
+		exit(1);
+	}
+	file_ptr = live.file_ptr;
+	ddr_hit_txns += live.ddr_hits - ddr_hits;
+	wr_count += live.records - records;
+}
+
+static void print_stats_summary(const struct flc_stats *st)
+{
+	printf("stats : %" PRIu64 " txns, ipm hit %.2f %%, ddr hit %.2f %%, longest miss burst %" PRIu64 "\n",
+		st->total.txns, stats_rate(st->total.ipm_hits, st->total.txns),
+		stats_rate(st->total.ddr_hits, st->total.txns - st->total.ipm_hits),
+		st->burst_max);
+}
+
+/* Everything after the last mapped miss was a hit, close the stats of this trace with it */
+int stats_finish_trace(struct flc_stats *st, FILE *trace_file, uint64_t pos, const char *regions_name)
+{
+	size_t trace_size = 0;
+	const uint64_t *trace;
+	if(map_file(fileno(trace_file), (const void **)&trace, &trace_size) < 0)
+	{
+		printf("stats : could not map the trace file: %s\n", strerror(errno));
+		stats_end(st, regions_name);
+		return -1;
+	}
+	if(trace)
 	{
-	 	miss_number = serial_number & 0x7fffffffffffffff;
-		//printf("mis_number :  %d\n",miss_number);
-		hit_count = 0;
-		while(file_ptr < (miss_number) && file_ptr != miss_number)
-        	{
-			if(fread(&pkt,sizeof(pkt), 1, fdr) == 0)break;
-			++file_ptr;
-                	address_offset = (pkt >> 16 ) & 0xFFFFFFFF;
-                	if(hit_count < 100){
-				fprintf(wr_file,"0x%08lx,0x%08lx,y,n\n",file_ptr,address_offset);
-				wr_count ++;
+		stats_feed_hits(st, trace, pos, trace_size / sizeof(uint64_t));
+		munmap((void *)trace, trace_size);
+	}
+	return stats_end(st, regions_name);
+}
+
+//Trace replay ring
+#define RING_DES 8		//descriptors and SIZE buffer slots reused for every trace file
+#define CHUNK_SIZE 0x1FFFFF8	//largest whole number of packets that fits the descriptor length field
+#define TRACE_BUF_BASE 0x180000000ULL
+#define DES_STATUS_REG_OFFSET 0x1C
+#define DES_STATUS_CMPLT 0x80000000
+
+/*
+ * Shared between the upload thread and the replay loop in main(). Chunks are
+ * numbered over all trace files, chunk n always lives in ring slot n % RING_DES.
+ */
+struct upload_ring {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	char **files;
+	int num_files;
+	uint64_t uploaded;	//chunks copied to device memory
+	uint64_t released;	//chunks the DMA is done with, their slots can be overwritten
+	int failed;
+	int stop;		//set by main() when no more chunks will be replayed
+	double busy;		//seconds spent uploading
+};
+
+static uint64_t trace_chunks(uint64_t fsize)
+{
+	return (fsize + CHUNK_SIZE - 1) / CHUNK_SIZE;
+}
+
+static uint32_t chunk_len(uint64_t fsize, uint64_t chunk)
+{
+	uint64_t left = fsize - chunk * CHUNK_SIZE;
+	return left < CHUNK_SIZE ? left : CHUNK_SIZE;
+}
+
+/* Streams every trace file through the ring, one chunk ahead of the DMA as long as slots are free */
+static void *upload_traces(void *arg)
+{
+	struct upload_ring *r = arg;
+	uint64_t seq = 0, fsize, len;
+	struct stat st;
+	char *buf = NULL;
+	double start;
+	int h2c, in;
+
+	h2c = open("/dev/xdma0_h2c_0", O_RDWR);
+	if(h2c < 0 || posix_memalign((void **)&buf, 4096, CHUNK_SIZE) != 0)
+	{
+		printf("Could not set up trace upload\n");
+		goto fail;
+	}
+	for(int file = 0; file < r->num_files; file++)
+	{
+		in = open(r->files[file], O_RDONLY);
+		if(in < 0 || fstat(in, &st) < 0)
+		{
+			printf("Error in opening trace file %s\n", r->files[file]);
+			goto fail;
+		}
+		fsize = st.st_size;
+		for(uint64_t c = 0; c < trace_chunks(fsize); c++, seq++)
+		{
+			len = chunk_len(fsize, c);
+			pthread_mutex_lock(&r->lock);
+			while(!r->stop && seq - r->released >= RING_DES)
+				pthread_cond_wait(&r->cond, &r->lock);
+			pthread_mutex_unlock(&r->lock);
+			if(r->stop)
+			{
+				close(in);
+				goto out;
 			}
-			hit_count++;
+
+			start = now_sec();
+			if(pread(in, buf, len, c * CHUNK_SIZE) != (ssize_t)len ||
+			   pwrite(h2c, buf, len, TRACE_BUF_BASE + (seq % RING_DES) * SIZE) != (ssize_t)len)
+			{
+				printf("Upload of chunk %" PRIu64 " of %s failed\n", c, r->files[file]);
+				close(in);
+				goto fail;
+			}
+
+			pthread_mutex_lock(&r->lock);
+			r->busy += now_sec() - start;
+			r->uploaded = seq + 1;
+			pthread_cond_broadcast(&r->cond);
+			pthread_mutex_unlock(&r->lock);
 		}
-		if(fread(&pkt,sizeof(pkt), 1, fdr) == 0)break;
-		++file_ptr;
-                address_offset = (pkt >> 16 ) & 0xFFFFFFFF;
-		if(serial_number & 0x8000000000000000)
+		close(in);
+	}
+out:
+	close(h2c);
+	free(buf);
+	return NULL;
+fail:
+	if(h2c >= 0)
+		close(h2c);
+	free(buf);
+	pthread_mutex_lock(&r->lock);
+	r->failed = 1;
+	pthread_cond_broadcast(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+	return NULL;
+}
+
+static void program_descriptor(uint32_t slot, uint32_t len)
+{
+	uint32_t des = slot * DES_SIZE;
+	writel(((slot + 1) % RING_DES) * DES_SIZE, des + DES_NEXT_DES_REG_OFFSET);
+	writel(0x00000000, des + DES_NEXT_DES_MSB_REG_OFFSET);
+	writel(INIT_BUF_ADDRESS + slot * SIZE, des + DES_BUF_ADDRESS_REG_OFFSET);
+	writel(BUF_ADDRESS_HIGH, des + DES_BUF_ADDRESS_HIGH_REG_OFFSET);
+	writel(len, des + DES_CONTROL_REG_OFFSET);
+	writel(0x00000000, des + DES_STATUS_REG_OFFSET);	//clear Cmplt left over from the previous lap
+}
+
+//Trace processing queue
+struct trace_job {
+	int file;		//1 based, as in the stats files
+	char *trace_name;
+	char miss_name[64];
+};
+
+/*
+ * Files whose replay is done are pushed by main() and picked up by the workers
+ * in order. Results are appended to the run wide outputs strictly in file
+ * order, whatever order the workers finish in.
+ */
+struct work_queue {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct trace_job *jobs;
+	int queued;
+	int next;		//next job a worker picks up
+	int committed;		//jobs appended to the run wide outputs
+	int closed;
+	long mapper_threads;	//miss mapper threads per job
+};
+
+static void append_part(const char *part, const char *dst)
+{
+	char buf[0x10000];
+	size_t n;
+	FILE *in = fopen(part, "rb");
+	FILE *out = fopen(dst, "ab");
+	if(in && out)
+	{
+		while((n = fread(buf, 1, sizeof(buf), in)) > 0)
+			fwrite(buf, 1, n, out);
+	}
+	if(in)
+		fclose(in);
+	if(out)
+		fclose(out);
+	remove(part);
+}
+
+static void *trace_worker(void *arg)
+{
+	struct work_queue *q = arg;
+	struct flc_stats *st = calloc(1, sizeof(*st));
+	struct trace_job *j;
+	struct map_ctx ctx;
+	char txt[64], bin[64], windows[64], regions[64];
+	FILE *trace;
+	int n, ok;
+
+	if(st == NULL)
+		return NULL;
+	for(;;)
+	{
+		pthread_mutex_lock(&q->lock);
+		while(q->next == q->queued && !q->closed)
+			pthread_cond_wait(&q->cond, &q->lock);
+		if(q->next == q->queued)
 		{
-                	fprintf(wr_file,"0x%08lx,0x%08lx,n,n\n",file_ptr,address_offset);
-				wr_count ++;
+			pthread_mutex_unlock(&q->lock);
+			break;
 		}
-		else
+		n = q->next++;
+		j = &q->jobs[n];
+		pthread_mutex_unlock(&q->lock);
+
+		snprintf(txt, sizeof(txt), "txns_file%d.txt", j->file);
+		snprintf(bin, sizeof(bin), "txns_file%d.bin", j->file);
+		snprintf(windows, sizeof(windows), "stats_windows%d.csv", j->file);
+		snprintf(regions, sizeof(regions), "stats_regions%d.csv", j->file);
+		memset(&ctx, 0, sizeof(ctx));
+		ctx.stats = st;
+		ctx.txt_name = txt;
+		ctx.bin_name = bin;
+		ctx.max_threads = q->mapper_threads;
+		ctx.quiet = 1;
+
+		trace = fopen(j->trace_name, "rb");
+		ok = trace != NULL && stats_begin(st, j->file, j->trace_name, windows) == 0 &&
+		     map_misses(&ctx, trace, j->miss_name) == 0 &&
+		     stats_finish_trace(st, trace, ctx.file_ptr, regions) == 0;
+		if(trace)
+			fclose(trace);
+		remove(j->miss_name);
+
+		pthread_mutex_lock(&q->lock);
+		while(q->committed != n)
+			pthread_cond_wait(&q->cond, &q->lock);
+		pthread_mutex_unlock(&q->lock);
+
+		if(TXNS_TEXT_OUTPUT)
+			append_part(txt, "txns_file.txt");
+		append_part(bin, "txns_file.bin");
+		append_part(windows, "stats_windows.csv");
+		append_part(regions, "stats_regions.csv");
+		if(ok)
 		{
-                	fprintf(wr_file,"0x%08lx,0x%08lx,n,y\n",file_ptr,address_offset);
-			wr_count ++;
-			ddr_hit_txns ++;
+			printf("file %d : %" PRIu64 " records, %" PRIu64 " ddr hits\n", j->file, ctx.records, ctx.ddr_hits);
+			print_stats_summary(st);
 		}
+		else
+			printf("file %d : processing of %s failed\n", j->file, j->trace_name);
+
+		pthread_mutex_lock(&q->lock);
+		q->committed++;
+		pthread_cond_broadcast(&q->cond);
+		pthread_mutex_unlock(&q->lock);
 	}
-        fflush(wr_file);
-        fclose(wr_file);
-        fclose(miss_file);
+	free(st->reuse);
+	free(st);
+	return NULL;
 }
+
 #if 0
 uint32_t fill_write_descriptors_and_start_dma(uint64_t transfer_size) 
 {
@@ -154,6 +774,16 @@ uint32_t fill_write_descriptors_and_start_dma(uint64_t transfer_size)
 int main(int argc,char* argv[])
 {
 	char enter;
+	//-j <workers> maps misses and builds stats after each file on a worker pool, 0 keeps the live mapping
+	int workers = 0;
+	if(argc > 2 && strcmp(argv[1], "-j") == 0)
+	{
+		workers = getopt_integer(argv[2]);
+		if(workers < 0)
+			workers = 0;
+		argv += 2;
+		argc -= 2;
+	}
 //    writel(0x0,SYS_RSTN);
 //    sleep(1);
 //    writel(0x1,SYS_RSTN);
@@ -167,6 +797,10 @@ int main(int argc,char* argv[])
 
 	FILE* wr_file = fopen("txns_file.txt","w");
 	fclose(wr_file);
+	wr_file = fopen("txns_file.bin","wb");
+	fclose(wr_file);
+	if(stats_reset_outputs() < 0)
+		printf("Could not create the statistics files\n");
 
 	int res = system("sh axi_dma.sh");
 
@@ -184,8 +818,6 @@ int main(int argc,char* argv[])
 	uint64_t transfer_count = 1;
 	uint64_t fsize=0, j = 0, div = 1;
 	int fdw,size;
-	uint64_t access_size = SIZE;
-	uint64_t address_offset = 0x180000000;
 	uint64_t written_address_offset = 0x140000000;
 	uint64_t written_data_bytes = 0;
 	uint64_t comp_written_data_bytes = 0;
@@ -193,17 +825,6 @@ int main(int argc,char* argv[])
 	printf("\nThe Number of files is %d\n",num_files);
 	FILE *fdr[num_files];
 	FILE *fdr1;
-	uint32_t next_des_reg = DES_NEXT_DES_REG_OFFSET;
-	uint32_t next_des_val = DES_NEXT_DES_REG_OFFSET + DES_SIZE;
-	uint32_t next_des_msb_reg = DES_NEXT_DES_MSB_REG_OFFSET;
-	uint32_t next_des_msb_val = 0x00000000;
-	uint32_t buf_address_val = INIT_BUF_ADDRESS;
-	uint32_t buf_address_reg = DES_BUF_ADDRESS_REG_OFFSET;
-	uint32_t buf_address_high_val = BUF_ADDRESS_HIGH;
-	uint32_t buf_address_high_reg = DES_BUF_ADDRESS_HIGH_REG_OFFSET;
-	uint32_t control_val = SIZE-1;
-	uint32_t control_reg = DES_CONTROL_REG_OFFSET;
-	int k=0;
 	uint32_t mm2s_dma_control_reg = 0x50000;
 	uint32_t mm2s_current_des_pointer_reg = 0x50008;
 	uint32_t mm2s_tail_des_pointer_reg = 0x50010;
@@ -212,126 +833,88 @@ int main(int argc,char* argv[])
 	uint32_t mm2s_tail_des_pointer_val;
 	//Determining the number of descriptors required
 	int des = 0;
-	uint32_t rem = 0;
 	uint32_t transactions = 0;
 	uint32_t val0,val1,val2,val3,val4,val5,des_val,prog,seconds = 0;
 	uint32_t total_txns,hit_txns,ipm_miss_txns,ddr_miss_txns=0;
 	float percent = 0;
 	uint32_t value_1 = readl(0x10000);
 	uint32_t value_2 = readl(0x1001C);
+
+	//trace files are uploaded by a separate thread while earlier chunks replay
+	struct upload_ring ring = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+		.files = &argv[2],
+		.num_files = num_files,
+	};
+	pthread_t upload_tid;
+	uint64_t first_chunk = 0;
+	double run_start = now_sec(), replay_busy = 0;
+	if(pthread_create(&upload_tid, NULL, upload_traces, &ring) != 0)
+	{
+		printf("Could not start the upload thread\n");
+		return 1;
+	}
+
+	//mapping and stats of file i run on the workers while file i+1 replays
+	struct work_queue queue = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+	};
+	pthread_t worker_tid[workers > 0 ? workers : 1];
+	if(workers > 0)
+	{
+		queue.jobs = calloc(num_files, sizeof(*queue.jobs));
+		queue.mapper_threads = sysconf(_SC_NPROCESSORS_ONLN) / workers;
+		if(queue.jobs == NULL)
+		{
+			printf("Could not allocate the work queue\n");
+			return 1;
+		}
+		for(int w = 0; w < workers; w++)
+		{
+			if(pthread_create(&worker_tid[w], NULL, trace_worker, &queue) != 0)
+			{
+				printf("Could not start worker %d\n", w);
+				return 1;
+			}
+		}
+	}
 	for(int file=0;file<num_files;file++)
 	{
-		address_offset = 0x180000000;
-		val0,val1,val2,val3,val4,val5,des_val,prog = 0;
-		total_txns,hit_txns,ipm_miss_txns,ddr_hit_txns,ddr_miss_txns=0;
+		file_ptr = 0;
+		val0 = val1 = val2 = val3 = val4 = val5 = des_val = prog = 0;
+		total_txns = hit_txns = ipm_miss_txns = ddr_miss_txns = 0;
+		ddr_hit_txns = 0;
 		printf("Reading trace file %s\n", argv[2+file]);
 		fdr1 = fopen(argv[2+file],"rb");	
-		if(fdr1 == NULL)printf("Error in opening trace file");
-		else printf("Trace file opened %d\n", fdr1);
+		if(fdr1 == NULL)
+		{
+			printf("Error in opening trace file");
+			break;
+		}
+		else printf("Trace file opened %s\n", argv[2+file]);
 		fseek(fdr1, 0L, SEEK_END);
 		fsize = ftell(fdr1);
-		printf("File size is : 0x%x\n", fsize);
-		des = fsize/SIZE;
-		rem = fsize%SIZE;
+		printf("File size is : 0x%" PRIx64 "\n", fsize);
+		des = trace_chunks(fsize);
 		transactions = fsize/8;
-		printf("remiander  : 0x%x\n", rem);
 		printf("transactions  : 0x%x\n", transactions);
-		des = des+1;
 		printf("\nNo of descriptors needed for file %d : 0x%x\n",file+1, des);
 		fseek(fdr1, 0L, SEEK_SET);
 
-		//Writing data to the DDR 
-		printf("\nDumping data of file %d to Memory started\n",file+1);	
-		for(int j = 0;j<des;j++)
-		{
-			if(j==0)
-			{
-				address_offset = (address_offset);
-			}
-			else
-			{
-				address_offset = ((address_offset) + (access_size));
-			}
-			if(j==(des-1))
-			{
-				dump_data("/dev/xdma0_h2c_0" , address_offset,0x00,rem,0x00 , transfer_count, argv[2+file] , NULL);
-				//printf("\nThe address offset 0x%16lx",address_offset);
-			}
-			else
-			{
-			        dump_data("/dev/xdma0_h2c_0" , address_offset,0x00,access_size,0x00 , transfer_count, argv[2+file] , NULL);
-				//printf("\nThe address offset 0x%16lx",address_offset);
-			}
-		}
-	
-		printf("\nDumping data of file %d to Memory completed",file+1);	
-
-		//populating the descriptor registers 
-			
-		for(k;k<des;k++)
-		{
-			if(k==0)
-			{
-				next_des_val = next_des_val;
-			}
-			else
-			{
-				next_des_val = ((k+1)*DES_SIZE)+DES_NEXT_DES_REG_OFFSET;
-			}
-			buf_address_val = (k*SIZE)+INIT_BUF_ADDRESS;
-			buf_address_reg = next_des_reg + DES_BUF_ADDRESS_REG_OFFSET;
-			buf_address_high_reg = next_des_reg + DES_BUF_ADDRESS_HIGH_REG_OFFSET;
-			control_reg = next_des_reg + DES_CONTROL_REG_OFFSET;
-			next_des_msb_reg = next_des_reg + DES_NEXT_DES_MSB_REG_OFFSET;
-
-			if(k==(des-1))
-			{
-			}
-			else
-			{
-			}
-			writel(next_des_val,next_des_reg);
-			writel(next_des_msb_val,next_des_msb_reg);
-			writel(buf_address_val,buf_address_reg);
-			writel(buf_address_high_val,buf_address_high_reg);
-			if(k==(des-1))
-			{
-				writel(rem,control_reg);
-			}
-			else
-			{
-				writel(control_val,control_reg);
-			}
+		if(workers == 0 && stats_begin(&trace_stats, file+1, argv[2+file], "stats_windows.csv") < 0)
+			printf("Could not start statistics for file %d\n", file+1);
 
+		// chunks [first_chunk, first_chunk + des) of the upload ring belong to this file
+		uint64_t programmed = first_chunk, completed = first_chunk, avail;
+		int started = 0, upload_failed = 0;
+		double file_start = now_sec(), next_monitor = file_start;
 
-			if(k==(des-1))
-			{
-				next_des_reg = next_des_reg;
-			}
-			else
-			{
-				next_des_reg = next_des_val;
-			}
-			printf("\n");
-		}
-		
-		mm2s_tail_des_pointer_val = next_des_reg;	
-		//Initializing the DMA registers
-		mm2s_dma_control_val = 0x00000004; //need to review the value
-		writel(mm2s_dma_control_val,mm2s_dma_control_reg);
-		writel(mm2s_current_des_pointer_val,mm2s_current_des_pointer_reg);
-		mm2s_dma_control_val = 0x00011013; //need to review the value
-		writel(mm2s_dma_control_val,mm2s_dma_control_reg);
-		writel(0x00000000,0x0005000C);
-		writel(mm2s_tail_des_pointer_val,mm2s_tail_des_pointer_reg);
-		writel(0x00000000,0x00050014);
-	        
 		// set ddr_ptr = trans_info ptr
 		uint64_t ddr_ptr = DDR_BASE;
 		miss_count = 0;
 
-        	fseek(fdr1, 0L, SEEK_SET);
-
 		wr_count = 0;
 	
 		outputFile = fopen("output_file.txt", "w");
@@ -339,26 +922,71 @@ int main(int argc,char* argv[])
 		    fprintf(stderr, "Failed to open output file\n");
 		    return 1;
 		}
-		while((readl(0x50004) & 0x2) == 0)
+		while(completed < first_chunk + des)
 		{
-			des_val = readl(0x50008);
-			prog = (mm2s_tail_des_pointer_val-des_val)/128;
-			prog = des-prog;
+			pthread_mutex_lock(&ring.lock);
+			avail = ring.uploaded;
+			upload_failed = ring.failed;
+			pthread_mutex_unlock(&ring.lock);
+
+			//hand freshly uploaded chunks to the DMA by moving the tail
+			if(programmed < avail && programmed < first_chunk + des)
+			{
+				for(; programmed < avail && programmed < first_chunk + des; programmed++)
+					program_descriptor(programmed % RING_DES, chunk_len(fsize, programmed - first_chunk));
+				mm2s_tail_des_pointer_val = ((programmed - 1) % RING_DES) * DES_SIZE;
+				if(!started)
+				{
+					//Initializing the DMA registers
+					mm2s_dma_control_val = 0x00000004; //need to review the value
+					writel(mm2s_dma_control_val,mm2s_dma_control_reg);
+					mm2s_current_des_pointer_val = (first_chunk % RING_DES) * DES_SIZE;
+					writel(mm2s_current_des_pointer_val,mm2s_current_des_pointer_reg);
+					mm2s_dma_control_val = 0x00011013; //need to review the value
+					writel(mm2s_dma_control_val,mm2s_dma_control_reg);
+					writel(0x00000000,0x0005000C);
+					started = 1;
+				}
+				writel(0x00000000,0x00050014);
+				writel(mm2s_tail_des_pointer_val,mm2s_tail_des_pointer_reg);
+			}
+			else if(upload_failed && programmed >= avail && completed == programmed)
+			{
+				printf("Trace upload stopped, file %d replayed partially\n", file+1);
+				break;
+			}
+
+			//give completed slots back to the upload thread
+			while(completed < programmed && (readl((completed % RING_DES) * DES_SIZE + DES_STATUS_REG_OFFSET) & DES_STATUS_CMPLT))
+			{
+				completed++;
+				pthread_mutex_lock(&ring.lock);
+				ring.released = completed;
+				pthread_cond_broadcast(&ring.cond);
+				pthread_mutex_unlock(&ring.lock);
+			}
+
+			if(now_sec() < next_monitor)
+			{
+				usleep(1000);
+				continue;
+			}
+			next_monitor = now_sec() + 1;
+			prog = completed - first_chunk;
 			get_rd_perf_mon(&val0,&val1, &val2,&val3,&val4, &val5);
 			total_txns = val0 + val1;
 			hit_txns = val2 + val3;
 		        //ddr_hit_txns = val4 + val5;
 			ipm_miss_txns = total_txns - hit_txns;
 			printf("trace : %.2f\n",((float)prog/des)*100);
-			sleep(1);
 			//printf("miss count :  %d\n",miss_count);
 			//printf("ipm miss tranactions count :  %d\n",ipm_miss_txns);
-			if(miss_count < ipm_miss_txns)
+			if(workers == 0 && miss_count < ipm_miss_txns)
 			{
 				recieve_data("/dev/xdma0_c2h_0" , (DDR_BASE + miss_count*8),0x00,(ipm_miss_txns-miss_count)*8,0x00 , 0x1, "missed_txns_file.bin");
         			miss_mapper(fdr1,"missed_txns_file.bin");
 				miss_count = ipm_miss_txns; // ipm_miss_txns-miss_count > 1000 ? miss_count + 1000 : ipm_miss_txns;
-				sleep(5);
+				next_monitor = now_sec() + 5;
  			}
 			//printf("ddr hit tranactions count :  %ld\n",ddr_hit_txns);
 		        ddr_miss_txns = ipm_miss_txns - ddr_hit_txns;
@@ -371,12 +999,73 @@ int main(int argc,char* argv[])
 			*/
 			
 		}
+		while(started && (readl(0x50004) & 0x2) == 0)
+			usleep(1000);
+		get_rd_perf_mon(&val0,&val1, &val2,&val3,&val4, &val5);
+		ipm_miss_txns = (val0 + val1) - (val2 + val3);
+		if(workers > 0)
+		{
+			//the miss list leaves DDR before the next file overwrites it, the rest is up to the workers
+			struct trace_job *job = &queue.jobs[file];
+			job->file = file+1;
+			job->trace_name = argv[2+file];
+			snprintf(job->miss_name, sizeof(job->miss_name), "missed_txns_file%d.bin", file+1);
+			fclose(fopen(job->miss_name, "wb"));
+			if(ipm_miss_txns > 0)
+				recieve_data("/dev/xdma0_c2h_0" , DDR_BASE,0x00,ipm_miss_txns*8,0x00 , 0x1, job->miss_name);
+			pthread_mutex_lock(&queue.lock);
+			queue.queued++;
+			pthread_cond_broadcast(&queue.cond);
+			pthread_mutex_unlock(&queue.lock);
+		}
+		else
+		{
+			//misses since the last poll are still in DDR, map them before closing the stats
+			if(miss_count < ipm_miss_txns)
+			{
+				recieve_data("/dev/xdma0_c2h_0" , (DDR_BASE + miss_count*8),0x00,(ipm_miss_txns-miss_count)*8,0x00 , 0x1, "missed_txns_file.bin");
+				miss_mapper(fdr1,"missed_txns_file.bin");
+				miss_count = ipm_miss_txns;
+			}
+			if(stats_finish_trace(&trace_stats, fdr1, file_ptr, "stats_regions.csv") < 0)
+				printf("Could not write the statistics of file %d\n", file+1);
+			print_stats_summary(&trace_stats);
+		}
+		//a cut short file only used the chunks that made it into the ring
+		first_chunk = upload_failed ? programmed : first_chunk + des;
+		replay_busy += now_sec() - file_start;
 		//perf_mon_dump(file,ddr_hit_txns);
 	        fclose(outputFile);
 		printf("\n");
 		fclose(fdr1);
+		//nothing more will be uploaded, the remaining files would wait forever
+		if(upload_failed)
+		{
+			if(file + 1 < num_files)
+				printf("Skipping the remaining %d trace files\n", num_files - file - 1);
+			break;
+		}
+	}
+	//the upload thread may still wait for a slot if a file was cut short
+	pthread_mutex_lock(&ring.lock);
+	ring.stop = 1;
+	pthread_cond_broadcast(&ring.cond);
+	pthread_mutex_unlock(&ring.lock);
+	pthread_join(upload_tid, NULL);
+	if(workers > 0)
+	{
+		pthread_mutex_lock(&queue.lock);
+		queue.closed = 1;
+		pthread_cond_broadcast(&queue.cond);
+		pthread_mutex_unlock(&queue.lock);
+		for(int w = 0; w < workers; w++)
+			pthread_join(worker_tid[w], NULL);
+		free(queue.jobs);
 	}
+	printf("Upload %.2f s, replay %.2f s, total %.2f s\n", ring.busy, replay_busy, now_sec() - run_start);
 	printf("Please copy the txns_file.txt for gui to process furthur \n");
+	printf("Binary records (index, address, ipm hit, ddr hit) are in txns_file.bin\n");
+	printf("Statistics are in stats_windows.csv, stats_regions.csv and stats_file<n>.json\n");
 
 	uint32_t read_size = ipm_miss_txns * 8;
 	recieve_data("/dev/xdma0_c2h_0" , 0x140000000,0x00,read_size ,0x00 , 0x1, "final_missed_txns_file.bin");
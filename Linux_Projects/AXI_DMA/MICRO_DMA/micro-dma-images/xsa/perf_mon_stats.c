@@ -0,0 +1,253 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/*
+ * Streaming hit/miss statistics for the FLC trace replay.
+ *
+ * Transactions are fed in trace order, once each. Memory use is fixed: the
+ * region table covers the 32 bit address space, time windows are written to
+ * CSV as soon as they close and reuse is tracked in a fixed size table.
+ */
+
+//Stats params
+#define STATS_LINE_SHIFT 6		//reuse is tracked per 64 byte line
+#define STATS_REGION_SHIFT 24		//16MB address regions
+#define STATS_REGIONS (1 << (32 - STATS_REGION_SHIFT))
+#define STATS_WINDOW_TXNS 0x100000	//transactions per time window
+#define STATS_HIST_BUCKETS 48		//log2 buckets, bucket n holds [2^(n-1), 2^n)
+#define STATS_REUSE_BITS 20		//lines remembered for reuse distance
+#define STATS_SAMPLE_SHIFT 0		//track reuse for 1 in 2^n lines only, 0 tracks every line
+#define STATS_EMPTY_LINE 0xFFFFFFFF	//marks an unused reuse slot, no 32 bit address shifts down to it
+
+struct hit_counts {
+	uint64_t txns;
+	uint64_t ipm_hits;
+	uint64_t ddr_hits;		//ipm miss that hit in DDR
+	uint64_t ddr_misses;
+};
+
+struct reuse_slot {
+	uint32_t line;
+	uint32_t reserved;
+	uint64_t last;			//trace index of the last access
+};
+
+struct flc_stats {
+	int file;
+	const char *name;
+	uint64_t pos;			//transactions fed so far
+	struct hit_counts total;
+	struct hit_counts region[STATS_REGIONS];
+	struct hit_counts window;
+	uint64_t window_index;
+	//reuse distance is the number of transactions between two accesses to a line
+	uint64_t reuse_hist[STATS_HIST_BUCKETS];
+	uint64_t reuse_sampled;
+	uint64_t reuse_cold;		//first touch, or the line was pushed out of the table
+	struct reuse_slot *reuse;
+	uint64_t burst_hist[STATS_HIST_BUCKETS];
+	uint64_t burst_len;
+	uint64_t burst_max;
+	FILE *window_csv;
+};
+
+static int stats_bucket(uint64_t v)
+{
+	int b = v ? 64 - __builtin_clzll(v) : 0;
+	return b < STATS_HIST_BUCKETS ? b : STATS_HIST_BUCKETS - 1;
+}
+
+static uint32_t stats_hash(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return x;
+}
+
+static void stats_count(struct hit_counts *c, int ipm_hit, int ddr_hit)
+{
+	c->txns++;
+	if(ipm_hit)
+		c->ipm_hits++;
+	else if(ddr_hit)
+		c->ddr_hits++;
+	else
+		c->ddr_misses++;
+}
+
+static double stats_rate(uint64_t part, uint64_t whole)
+{
+	return whole ? (double)part / whole * 100 : 0.0;
+}
+
+static void stats_flush_window(struct flc_stats *st)
+{
+	struct hit_counts *w = &st->window;
+	if(w->txns == 0)
+		return;
+	if(st->window_csv)
+		fprintf(st->window_csv, "%d,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.4f\n",
+			st->file, st->window_index, st->window_index * STATS_WINDOW_TXNS + 1,
+			w->txns, w->ipm_hits, w->ddr_hits, w->ddr_misses, stats_rate(w->ipm_hits, w->txns));
+	memset(w, 0, sizeof(*w));
+}
+
+static void stats_flush_burst(struct flc_stats *st)
+{
+	if(st->burst_len == 0)
+		return;
+	st->burst_hist[stats_bucket(st->burst_len)]++;
+	if(st->burst_len > st->burst_max)
+		st->burst_max = st->burst_len;
+	st->burst_len = 0;
+}
+
+/* Truncates the CSV outputs and writes their headers, called once per run */
+int stats_reset_outputs(void)
+{
+	FILE *f = fopen("stats_windows.csv", "w");
+	if(f == NULL)
+		return -1;
+	fprintf(f, "file,window,first_txn,txns,ipm_hits,ddr_hits,ddr_misses,ipm_hit_rate\n");
+	fclose(f);
+	f = fopen("stats_regions.csv", "w");
+	if(f == NULL)
+		return -1;
+	fprintf(f, "file,region_base,txns,ipm_hits,ddr_hits,ddr_misses,ipm_hit_rate\n");
+	fclose(f);
+	return 0;
+}
+
+/* Window rows go to windows_name, the run wide CSV or a per file part that is appended later */
+int stats_begin(struct flc_stats *st, int file, const char *name, const char *windows_name)
+{
+	struct reuse_slot *reuse = st->reuse;
+	memset(st, 0, sizeof(*st));
+	st->file = file;
+	st->name = name;
+	if(reuse == NULL)
+		reuse = malloc(sizeof(*reuse) << STATS_REUSE_BITS);
+	if(reuse == NULL)
+		return -1;
+	for(uint32_t i = 0; i < (1U << STATS_REUSE_BITS); i++)
+	{
+		reuse[i].line = STATS_EMPTY_LINE;
+		reuse[i].last = 0;
+	}
+	st->reuse = reuse;
+	st->window_csv = fopen(windows_name, "a");
+	return st->window_csv ? 0 : -1;
+}
+
+/* Feed the transaction at 1 based trace position index, calls must come in trace order */
+void stats_add(struct flc_stats *st, uint64_t index, uint32_t address, int ipm_hit, int ddr_hit)
+{
+	uint32_t line = address >> STATS_LINE_SHIFT;
+	uint32_t h = stats_hash(line);
+	uint64_t window = (index - 1) / STATS_WINDOW_TXNS;
+
+	if(window != st->window_index)
+	{
+		stats_flush_window(st);
+		st->window_index = window;
+	}
+	stats_count(&st->total, ipm_hit, ddr_hit);
+	stats_count(&st->region[address >> STATS_REGION_SHIFT], ipm_hit, ddr_hit);
+	stats_count(&st->window, ipm_hit, ddr_hit);
+
+	if(ipm_hit)
+		stats_flush_burst(st);
+	else
+		st->burst_len++;
+
+	if((h & ((1U << STATS_SAMPLE_SHIFT) - 1)) == 0)
+	{
+		struct reuse_slot *s = &st->reuse[h >> (32 - STATS_REUSE_BITS)];
+		st->reuse_sampled++;
+		if(s->line == line)
+			st->reuse_hist[stats_bucket(index - s->last)]++;
+		else
+			st->reuse_cold++;
+		s->line = line;
+		s->last = index;
+	}
+	st->pos = index;
+}
+
+/* Writes s as a quoted JSON string, escaping quotes, backslashes and control characters */
+static void stats_json_string(FILE *f, const char *s)
+{
+	fputc('"', f);
+	for(; *s; s++)
+	{
+		unsigned char c = *s;
+		if(c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if(c == '\n')
+			fputs("\\n", f);
+		else if(c == '\t')
+			fputs("\\t", f);
+		else if(c < 0x20)
+			fprintf(f, "\\u%04x", c);
+		else
+			fputc(c, f);
+	}
+	fputc('"', f);
+}
+
+/* Writes the per file summary to stats_file<n>.json and its regions to regions_name */
+int stats_end(struct flc_stats *st, const char *regions_name)
+{
+	char name[64];
+	FILE *f;
+	int first, last;
+
+	stats_flush_window(st);
+	stats_flush_burst(st);
+	if(st->window_csv)
+		fclose(st->window_csv);
+	st->window_csv = NULL;
+
+	f = fopen(regions_name, "a");
+	if(f == NULL)
+		return -1;
+	for(int r = 0; r < STATS_REGIONS; r++)
+	{
+		struct hit_counts *c = &st->region[r];
+		if(c->txns)
+			fprintf(f, "%d,0x%08x,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.4f\n",
+				st->file, (uint32_t)r << STATS_REGION_SHIFT, c->txns, c->ipm_hits,
+				c->ddr_hits, c->ddr_misses, stats_rate(c->ipm_hits, c->txns));
+	}
+	fclose(f);
+
+	snprintf(name, sizeof(name), "stats_file%d.json", st->file);
+	f = fopen(name, "w");
+	if(f == NULL)
+		return -1;
+	fprintf(f, "{\n  \"file\": %d,\n  \"trace\": ", st->file);
+	stats_json_string(f, st->name);
+	fprintf(f, ",\n");
+	fprintf(f, "  \"txns\": %" PRIu64 ",\n  \"ipm_hits\": %" PRIu64 ",\n  \"ddr_hits\": %" PRIu64 ",\n  \"ddr_misses\": %" PRIu64 ",\n",
+		st->total.txns, st->total.ipm_hits, st->total.ddr_hits, st->total.ddr_misses);
+	fprintf(f, "  \"ipm_hit_rate\": %.4f,\n  \"ddr_hit_rate\": %.4f,\n",
+		stats_rate(st->total.ipm_hits, st->total.txns),
+		stats_rate(st->total.ddr_hits, st->total.txns - st->total.ipm_hits));
+	fprintf(f, "  \"window_txns\": %d,\n  \"region_bytes\": %d,\n  \"line_bytes\": %d,\n  \"sample_shift\": %d,\n",
+		STATS_WINDOW_TXNS, 1 << STATS_REGION_SHIFT, 1 << STATS_LINE_SHIFT, STATS_SAMPLE_SHIFT);
+	fprintf(f, "  \"reuse_sampled\": %" PRIu64 ",\n  \"reuse_cold\": %" PRIu64 ",\n", st->reuse_sampled, st->reuse_cold);
+
+	//histograms are printed up to the last non empty bucket
+	fprintf(f, "  \"reuse_distance_log2\": [");
+	for(last = STATS_HIST_BUCKETS - 1; last > 0 && st->reuse_hist[last] == 0; last--);
+	for(first = 0; first <= last; first++)
+		fprintf(f, "%s%" PRIu64, first ? ", " : "", st->reuse_hist[first]);
+	fprintf(f, "],\n  \"miss_burst_max\": %" PRIu64 ",\n  \"miss_burst_log2\": [", st->burst_max);
+	for(last = STATS_HIST_BUCKETS - 1; last > 0 && st->burst_hist[last] == 0; last--);
+	for(first = 0; first <= last; first++)
+		fprintf(f, "%s%" PRIu64, first ? ", " : "", st->burst_hist[first]);
+	fprintf(f, "]\n}\n");
+	fclose(f);
+	return 0;
+}
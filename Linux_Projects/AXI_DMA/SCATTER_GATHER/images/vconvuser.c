@@ -10,6 +10,7 @@
 #include <sys/mman.h>
 #include <errno.h>
 #include <sys/ioctl.h>
+#include <time.h>
 #define PAGE_SIZE 4096
 #define DEVICE_FILE "/dev/vconv_driver"
 #define BUFFER_SIZE_L (196 * 1024) 
@@ -328,11 +329,20 @@ int dma_func(void) {
 	}
 }
 
+/* Data patterns used to fill and verify DDR */
+#include "../mem_pattern.c"
+
 int common(int option) {
 	unsigned long phys_addr;
 	unsigned long mem_size;
 	int fd1;
+	int dump;
 	void *mapped;
+	struct mem_pattern pat;
+	struct mem_report rep;
+	size_t done;
+	double start;
+	int ret = 0;
 	off_t page_offset, aligned_addr;
 	while (1) {
 		printf("Enter the physical address (in hexadecimal format):\n");
@@ -351,6 +361,7 @@ int common(int option) {
 		clear_stdin();
 		break;
 	}
+	dump = select_pattern(&pat, option == 2);
 	/* Calculate page alignment */
 	page_offset = phys_addr % PAGE_SIZE;
 	aligned_addr = phys_addr - page_offset;
@@ -358,6 +369,7 @@ int common(int option) {
 	fd1 = open("/dev/mem", O_RDWR | O_SYNC);
 	if (fd1 < 0) {
 		perror("open");
+		pattern_close(&pat);
 		return -1;
 	}
 
@@ -365,6 +377,7 @@ int common(int option) {
 	if (mapped == MAP_FAILED) {
 		perror("mmap");
 		close(fd1);
+		pattern_close(&pat);
 		return -1;
 	}
 
@@ -372,36 +385,40 @@ int common(int option) {
 
 	volatile uint32_t *ptr = (volatile uint32_t *)((char *)mapped + page_offset);
 	size_t num_entries = mem_size / sizeof(uint32_t);
-	/* For Writing */
-	if (option==1) {
-		unsigned long input;
-		while (1) {
-			printf("Enter first number in the sequence that you want to write:\n");
-			if (scanf("%li", &input) != 1) {
-				printf("Invalid input! Try again.\n");
-				clear_stdin();
-				continue;
-			}
-			for (size_t i = 0; i < num_entries; i++) {
-				ptr[i] = (uint32_t)(input);
-				input ++;
-			}
-			clear_stdin();
-			break;
-		}
-	} else if(option == 2) {
+	if (dump) {
 		for (size_t i = 0; i < num_entries; i++) {
 			uint32_t value = ptr[i];
 			printf("Address: %p, Read: 0x%X\n", (void *)(ptr + i), value);
 		}
+	} else {
+		if (option == 1) {
+			/* For Writing, the data is read back right after */
+			start = now_sec();
+			done = mem_fill(ptr, num_entries, &pat);
+			print_rate("Wrote", done, now_sec() - start);
+			pattern_reset(&pat);
+		}
+		/* For Reading, only mismatches against the pattern are printed */
+		memset(&rep, 0, sizeof(rep));
+		rep.phys_base = phys_addr;
+		start = now_sec();
+		done = mem_verify(ptr, num_entries, &pat, &rep);
+		print_rate("Verified", done, now_sec() - start);
+		if (done < num_entries)
+			printf("Pattern ended after %zu bytes\n", done * sizeof(uint32_t));
+		if (rep.bad_words) {
+			printf("%zu mismatching words in %zu ranges\n", rep.bad_words, rep.ranges);
+			ret = -1;
+		}
 	}
+	pattern_close(&pat);
 
 	if (munmap(mapped, mem_size + page_offset) < 0) {
 		perror("munmap");
 	}
 
 	close(fd1);
-	return 0;
+	return ret;
 }
 
 
@@ -0,0 +1,273 @@
+/*
+ * Data patterns used to fill and verify DDR, shared by user.c and
+ * images/vconvuser.c. Include it after clear_stdin() is defined.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define PATTERN_INCREMENT 1
+#define PATTERN_PRBS 2
+#define PATTERN_FILE 3
+#define CHECK_BLOCK_WORDS 1024
+#define MAX_REPORTED_RANGES 16
+
+struct mem_pattern {
+    int type;
+    uint32_t seed;
+    uint32_t next;      /* next incrementing value or PRBS state */
+    FILE *file;
+};
+
+/* Mismatching words are merged into ranges, only the first few get printed */
+struct mem_report {
+    unsigned long phys_base;
+    size_t bad_words;
+    size_t ranges;
+    size_t range_start;
+    size_t range_end;
+    uint32_t expected;
+    uint32_t actual;
+};
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Ask for the pattern, returns 1 if the user wants the old word by word dump */
+static int select_pattern(struct mem_pattern *pat, int allow_dump)
+{
+    char path[256];
+    unsigned long input;
+    int choice;
+
+    memset(pat, 0, sizeof(*pat));
+    while (1) {
+        printf("Choose a data pattern:\n");
+        printf("1. Incrementing\n");
+        printf("2. PRBS\n");
+        printf("3. From file\n");
+        if (allow_dump)
+            printf("4. Print every word\n");
+        if (scanf("%d", &choice) != 1) {
+            printf("Invalid input! Try again.\n");
+            clear_stdin();
+            continue;
+        }
+        switch (choice) {
+        case 1:
+            printf("Enter first number in the sequence:\n");
+            if (scanf("%li", &input) != 1) {
+                printf("Invalid input! Try again.\n");
+                clear_stdin();
+                continue;
+            }
+            pat->seed = (uint32_t)input;
+            pat->type = PATTERN_INCREMENT;
+            break;
+        case 2:
+            printf("Enter the PRBS seed (non zero):\n");
+            if (scanf("%li", &input) != 1 || (uint32_t)input == 0) {
+                printf("Invalid input! Try again.\n");
+                clear_stdin();
+                continue;
+            }
+            pat->seed = (uint32_t)input;
+            pat->type = PATTERN_PRBS;
+            break;
+        case 3:
+            printf("Enter the file path:\n");
+            if (scanf("%255s", path) != 1) {
+                printf("Invalid input! Try again.\n");
+                clear_stdin();
+                continue;
+            }
+            pat->file = fopen(path, "rb");
+            if (!pat->file) {
+                perror("Failed to open file");
+                continue;
+            }
+            pat->type = PATTERN_FILE;
+            break;
+        case 4:
+            if (allow_dump)
+                return 1;
+            /* fall through */
+        default:
+            printf("Invalid choice.\n");
+            continue;
+        }
+        pat->next = pat->seed;
+        return 0;
+    }
+}
+
+static void pattern_reset(struct mem_pattern *pat)
+{
+    pat->next = pat->seed;
+    if (pat->file)
+        rewind(pat->file);
+}
+
+static void pattern_close(struct mem_pattern *pat)
+{
+    if (pat->file)
+        fclose(pat->file);
+    pat->file = NULL;
+}
+
+/* Produce the next n words of the pattern, a file pattern may return less */
+static size_t pattern_block(struct mem_pattern *pat, uint32_t *blk, size_t n)
+{
+    uint32_t x = pat->next;
+    size_t i;
+
+    if (pat->type == PATTERN_FILE)
+        return fread(blk, sizeof(uint32_t), n, pat->file);
+
+    for (i = 0; i < n; i++) {
+        if (pat->type == PATTERN_INCREMENT) {
+            blk[i] = x++;
+        } else {
+            /* xorshift32, never reaches zero from a non zero seed */
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            blk[i] = x;
+        }
+    }
+    pat->next = x;
+    return n;
+}
+
+/* Wide stores, the mapping is uncached so the number of bus beats matters */
+static void store_block(volatile uint32_t *dst, const uint32_t *src, size_t n)
+{
+    size_t i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 4 <= n; i += 4)
+        vst1q_u32((uint32_t *)(dst + i), vld1q_u32(src + i));
+#elif defined(__AVX2__)
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_loadu_si256((const __m256i *)(src + i)));
+#elif defined(__SSE2__)
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_loadu_si128((const __m128i *)(src + i)));
+#endif
+    for (; i < n; i++)
+        dst[i] = src[i];
+}
+
+/* Index of the first word from i that differs from exp, or n if none */
+static size_t first_mismatch(const volatile uint32_t *mem, const uint32_t *exp, size_t i, size_t n)
+{
+#if defined(__ARM_NEON)
+    for (; i + 4 <= n; i += 4) {
+        uint32x4_t ne = vmvnq_u32(vceqq_u32(vld1q_u32((const uint32_t *)(mem + i)), vld1q_u32(exp + i)));
+        uint32x2_t r = vorr_u32(vget_low_u32(ne), vget_high_u32(ne));
+        if (vget_lane_u32(vpmax_u32(r, r), 0))
+            break;
+    }
+#elif defined(__AVX2__)
+    for (; i + 8 <= n; i += 8) {
+        __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(mem + i)),
+                                        _mm256_loadu_si256((const __m256i *)(exp + i)));
+        if (_mm256_movemask_epi8(eq) != -1)
+            break;
+    }
+#elif defined(__SSE2__)
+    for (; i + 4 <= n; i += 4) {
+        __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(mem + i)),
+                                     _mm_loadu_si128((const __m128i *)(exp + i)));
+        if (_mm_movemask_epi8(eq) != 0xFFFF)
+            break;
+    }
+#endif
+    for (; i < n; i++) {
+        if (mem[i] != exp[i])
+            break;
+    }
+    return i;
+}
+
+static void report_flush(struct mem_report *rep)
+{
+    if (rep->range_end == rep->range_start)
+        return;
+    if (rep->ranges < MAX_REPORTED_RANGES) {
+        printf("Mismatch 0x%lX - 0x%lX (%zu words), first expected 0x%X read 0x%X\n",
+               rep->phys_base + rep->range_start * sizeof(uint32_t),
+               rep->phys_base + rep->range_end * sizeof(uint32_t) - 1,
+               rep->range_end - rep->range_start, rep->expected, rep->actual);
+    }
+    rep->ranges++;
+    rep->range_start = rep->range_end;
+}
+
+static void report_range(struct mem_report *rep, size_t start, size_t end, uint32_t expected, uint32_t actual)
+{
+    if (rep->range_end == rep->range_start || start != rep->range_end) {
+        report_flush(rep);
+        rep->range_start = start;
+        rep->expected = expected;
+        rep->actual = actual;
+    }
+    rep->range_end = end;
+    rep->bad_words += end - start;
+}
+
+static size_t mem_fill(volatile uint32_t *ptr, size_t num_entries, struct mem_pattern *pat)
+{
+    uint32_t blk[CHECK_BLOCK_WORDS];
+    size_t done = 0, n;
+
+    while (done < num_entries) {
+        n = num_entries - done < CHECK_BLOCK_WORDS ? num_entries - done : CHECK_BLOCK_WORDS;
+        n = pattern_block(pat, blk, n);
+        if (n == 0)
+            break;
+        store_block(ptr + done, blk, n);
+        done += n;
+    }
+    return done;
+}
+
+/* Compare memory against the pattern, returns the number of words checked */
+static size_t mem_verify(volatile uint32_t *ptr, size_t num_entries, struct mem_pattern *pat, struct mem_report *rep)
+{
+    uint32_t blk[CHECK_BLOCK_WORDS];
+    size_t done = 0, n, i, start;
+
+    while (done < num_entries) {
+        n = num_entries - done < CHECK_BLOCK_WORDS ? num_entries - done : CHECK_BLOCK_WORDS;
+        n = pattern_block(pat, blk, n);
+        if (n == 0)
+            break;
+        i = 0;
+        while ((i = first_mismatch(ptr + done, blk, i, n)) < n) {
+            start = i;
+            while (i < n && ptr[done + i] != blk[i])
+                i++;
+            report_range(rep, done + start, done + i, blk[start], ptr[done + start]);
+        }
+        done += n;
+    }
+    report_flush(rep);
+    return done;
+}
+
+static void print_rate(const char *what, size_t words, double secs)
+{
+    double bytes = (double)words * sizeof(uint32_t);
+    printf("%s %zu bytes in %.3f ms (%.3f GB/s)\n", what, words * sizeof(uint32_t),
+           secs * 1e3, secs > 0 ? bytes / secs / 1e9 : 0.0);
+}
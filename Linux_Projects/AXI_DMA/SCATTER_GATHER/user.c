@@ -10,6 +10,7 @@
 #include <sys/mman.h>
 #include <errno.h>
 #include <sys/ioctl.h>
+#include <time.h>
 #define PAGE_SIZE 4096
 #define DEVICE_FILE "/dev/vconv_driver"
 #define MAGIC_NUMBER 'a'
@@ -217,9 +218,18 @@ int dma_func(void){
     }
 }
 
+/* Data patterns used to fill and verify DDR */
+#include "mem_pattern.c"
+
 int common(int option){
     unsigned long phys_addr;
     unsigned long mem_size; 
+    struct mem_pattern pat;
+    struct mem_report rep;
+    size_t done;
+    double start;
+    int dump;
+    int ret = 0;
     // Ask the user for the physical address and memory size
     printf("Enter the physical address (in hexadecimal format):\n");
     if (scanf("%li", &phys_addr) != 1) {  
@@ -231,6 +241,7 @@ int common(int option){
     printf("Invalid input!\n");
     clear_stdin();  
     }	
+    dump = select_pattern(&pat, option == 2);
 
     int fd1;
     void *mapped;
@@ -244,6 +255,7 @@ int common(int option){
     fd1 = open("/dev/mem", O_RDWR | O_SYNC);
     if (fd1 < 0) {
         perror("open");
+        pattern_close(&pat);
         return -1;
     }
 
@@ -252,6 +264,7 @@ int common(int option){
     if (mapped == MAP_FAILED) {
         perror("mmap");
         close(fd1);
+        pattern_close(&pat);
         return -1;
     }
 
@@ -261,16 +274,33 @@ int common(int option){
     volatile uint32_t *ptr = (volatile uint32_t *)((char *)mapped + page_offset);
     size_t num_entries = mem_size / sizeof(uint32_t);
     
-    for (size_t i = 0; i < num_entries; i++) {
-	if (option == 1){
-        ptr[i] = (uint32_t)(0x00000000 + i); // Write unique value if called in writting context
-	} 
-        // Read back the value
-        uint32_t value = ptr[i];
-        printf("Address: %p, Read: 0x%X\n", (void *)(ptr + i), value);
-    } 
-
-       
+    if (dump) {
+        for (size_t i = 0; i < num_entries; i++) {
+            uint32_t value = ptr[i];
+            printf("Address: %p, Read: 0x%X\n", (void *)(ptr + i), value);
+        }
+    } else {
+        if (option == 1) {
+            start = now_sec();
+            done = mem_fill(ptr, num_entries, &pat);
+            print_rate("Wrote", done, now_sec() - start);
+            pattern_reset(&pat);
+        }
+        // Read back and compare, only mismatches are printed
+        memset(&rep, 0, sizeof(rep));
+        rep.phys_base = phys_addr;
+        start = now_sec();
+        done = mem_verify(ptr, num_entries, &pat, &rep);
+        print_rate("Verified", done, now_sec() - start);
+        if (done < num_entries)
+            printf("Pattern ended after %zu bytes\n", done * sizeof(uint32_t));
+        if (rep.bad_words) {
+            printf("%zu mismatching words in %zu ranges\n", rep.bad_words, rep.ranges);
+            ret = -1;
+        }
+    }
+    pattern_close(&pat);
+
     // Unmap memory
     if (munmap(mapped, mem_size + page_offset) < 0) {
         perror("munmap");
@@ -279,7 +309,7 @@ int common(int option){
     // Close /dev/mem
     close(fd1);
 
-    return 0;
+    return ret;
 
 }
 
@@ -14,6 +14,7 @@
 #include <linux/interrupt.h>
 #include <linux/netdevice.h>
 #include <linux/etherdevice.h>
+#include <linux/if_vlan.h> // For VLAN_ETH_HLEN
 #include <linux/platform_device.h>
 #include <linux/dma-mapping.h>
 #include <linux/phy.h> // For phylink and MII operations
@@ -23,16 +24,166 @@
 #include <linux/clk.h> // For clock management
 #include <linux/jiffies.h> // For mdelay/udelay
 #include <linux/iopoll.h> // For readx_poll_timeout
+#include <linux/ethtool.h> // For ethtool_ops
+#include <linux/hrtimer.h> // For software interrupt coalescing
+#include <linux/u64_stats_sync.h> // For 64-bit counters on 32-bit harts
+#include <linux/dim.h> // For adaptive RX interrupt moderation
+#include <linux/crc32.h> // For the multicast hash
+#include <linux/bpf.h> // For XDP programs
+#include <linux/bpf_trace.h> // For trace_xdp_exception
+#include <net/page_pool/helpers.h> // For RX page recycling
+#include <net/tso.h> // For TSO emulation
+#include <net/ip6_checksum.h> // For TSO segment checksums
+#include <net/xdp.h> // For XDP buffers and frames
+#include <net/xdp_sock_drv.h> // For AF_XDP zero-copy
 
 // Include our specific register definitions (assuming these are in a kernel-accessible path)
 #include "emac_reg.h" // Contains EMAC_MODE_OFFSET, EMAC_DMA_DESC_OFFSET, EMAC_BD_TX_RD, etc.
 #include "bflb_emac.h" // Contains EMAC_TX_BD_BUM_MAX, EMAC_RX_BD_BUM_MAX etc.
+#include "bl702_emac_sim.h" // Register file hooks of the host-side model
 // NOTE: In a real driver, you'd likely integrate these directly or create a bl702_emac_regs.h
 // and bl702_emac_hw.h specific for the kernel driver.
 
 #define DRV_NAME "bl702-emac"
 #define DRV_VERSION "0.1.0"
 
+// RX buffer layout: headroom for XDP and the stack, frame, then skb_shared_info for build_skb
+#define BL702_RX_HEADROOM (XDP_PACKET_HEADROOM + NET_IP_ALIGN)
+// Jumbo frames up to ETH_JUMBO_FRAME_PAYLOAD_SIZE (emac.h), larger MTUs take higher order RX pages
+#define BL702_MAX_MTU 9000
+// Most BDs one TX frame may use, frames split into more pieces are linearized
+#define BL702_TX_MAX_DESC 4
+// TSO skbs may use up to 1/BL702_TSO_RING_DIV of the TX ring, larger ones are segmented by the stack
+#define BL702_TSO_RING_DIV 4
+// TX frames reclaimed per NAPI poll, TX work does not count against the RX budget
+#define BL702_TX_CLEAN_BUDGET 64
+// Interrupt sources masked while NAPI polls, errors stay live
+#define BL702_NAPI_INT_MASK (EMAC_RXB_M | EMAC_RXC_M | EMAC_TXB_M | EMAC_TXC_M)
+// All interrupt sources the driver uses
+#define BL702_INT_MASK_ALL (BL702_NAPI_INT_MASK | EMAC_TXE_M | EMAC_RXE_M | EMAC_BUSY_M)
+// Frames shorter than this are copied into a small skb and the page stays on the ring
+#define BL702_RX_COPYBREAK_DEFAULT 256
+
+// Count register and BD accesses for ethtool -S mmio_reads/mmio_writes (rx_bench.sh mmio).
+// Debug builds only, the counters are atomics shared by every context.
+#define BL702_MMIO_STATS 0
+
+// Built with -DBL702_EMAC_SIM=1 (make SIM=1) the driver also binds to the host-side
+// model in bl702_emac_sim.c and reaches its registers through the platform data
+#ifndef BL702_EMAC_SIM
+#define BL702_EMAC_SIM 0
+#endif
+
+// BD memory spans 0x400-0x7FF (8 bytes per BD), split between TX and RX through EMAC_TX_BD_NUM
+#define BL702_BD_TOTAL 128
+#define BL702_RING_MIN 8
+// The MAC has one TX and one RX BD pointer (EMAC_TX_BD_NUM), so one queue pair and one NAPI.
+// Work spreads over harts with RPS and threaded NAPI instead, see README.md.
+#define BL702_NUM_QUEUES 1
+
+// Coalescing defaults, see bl702_emac_set_coalesce() for what the knobs mean on this MAC
+#define BL702_TX_COAL_FRAMES 8
+#define BL702_TX_COAL_USECS 1000
+#define BL702_RX_COAL_FRAMES 1
+#define BL702_RX_COAL_USECS 0
+#define BL702_COAL_USECS_MAX 10000
+
+// net_dim profiles for the RX holdoff, {rx-usecs, rx-frames}. Index 0 is light load and
+// re-enables interrupts at once, higher ones hold off longer. rx-frames stays below the
+// NAPI budget, a cycle that uses the whole budget never completes and never holds off.
+static const struct dim_cq_moder bl702_emac_rx_dim_profile[NET_DIM_PARAMS_NUM_PROFILES] = {
+    { .usec = 0, .pkts = 1 },
+    { .usec = 50, .pkts = 4 },
+    { .usec = 100, .pkts = 8 },
+    { .usec = 250, .pkts = 16 },
+    { .usec = 500, .pkts = 32 },
+};
+
+// Counters are grouped by the one context that writes them, so updates need
+// neither atomics nor locking. u64_stats_sync lets readers on 32-bit harts
+// retry instead of seeing a torn value and costs nothing on 64-bit.
+
+// Written by the queue's NAPI poll (RX and TX completion)
+struct bl702_emac_napi_counters {
+    u64 rx_packets;
+    u64 rx_bytes;
+    u64 rx_dropped;
+    u64 rx_errors;
+    u64 rx_crc_errors;
+    u64 rx_short_frames;
+    u64 rx_too_long;
+    u64 rx_dribble_nibble;
+    u64 rx_phy_errors;
+    u64 rx_overruns;
+    u64 rx_missed;
+    u64 rx_copybreak;
+    u64 rx_alloc_failures;
+    u64 rx_xdp_pass;
+    u64 rx_xdp_drop;
+    u64 rx_xdp_tx;
+    u64 rx_xdp_redirect;
+    u64 rx_xsk_fill_empty;
+    u64 tx_errors;
+    u64 tx_carrier_lost;
+    u64 tx_deferred;
+    u64 tx_late_collisions;
+    u64 tx_retry_limit;
+    u64 tx_underruns;
+};
+
+// Written by bl702_emac_start_xmit() and the XDP TX paths under the queue's xmit lock
+struct bl702_emac_xmit_counters {
+    u64 tx_packets;
+    u64 tx_bytes;
+    u64 tx_dropped;
+    u64 tx_tso_skbs;
+    u64 tx_xdp_frames;
+    u64 tx_xdp_full;
+    u64 tx_xsk_frames;
+    u64 tx_irq_requests;
+    u64 tx_coal_timer_starts;
+};
+
+// Written by the interrupt handler
+struct bl702_emac_irq_counters {
+    u64 rx_error_irqs;
+    u64 tx_error_irqs;
+    u64 rx_busy;
+};
+
+// NAPI and xmit run on different harts, their counters get separate cache lines
+struct bl702_emac_napi_stats {
+    struct bl702_emac_napi_counters c;
+    struct u64_stats_sync syncp;
+} ____cacheline_aligned_in_smp;
+
+struct bl702_emac_xmit_stats {
+    struct bl702_emac_xmit_counters c;
+    struct u64_stats_sync syncp;
+} ____cacheline_aligned_in_smp;
+
+struct bl702_emac_irq_stats {
+    struct bl702_emac_irq_counters c;
+    struct u64_stats_sync syncp;
+};
+
+// Software state of one TX BD. xmit fills it and cleanup empties it, one entry
+// is one 32-byte block and never straddles a cache line.
+struct bl702_emac_tx_entry {
+    struct sk_buff *skb; // skb of a frame, held by its last (EOF) BD
+    struct xdp_frame *xdpf; // XDP_TX or ndo_xdp_xmit frame, one BD each
+    dma_addr_t dma_addr;
+    u32 dma_len; // Mapping length for unmapping, 0 if unmapped
+    bool dma_page; // Frag mapping, undone with dma_unmap_page
+    bool xsk; // Last BD of an AF_XDP TX descriptor, sent from the UMEM
+} __aligned(32);
+
+// Software state of one RX BD, the buffer it was armed with
+struct bl702_emac_rx_entry {
+    struct page *page; // page_pool page
+    struct xdp_buff *xsk; // UMEM frame, NULL until bl702_emac_xsk_refill() arms the BD
+};
+
 // --- Driver Private Data Structure ---
 struct bl702_emac_priv {
     struct net_device *netdev;
@@ -41,58 +192,105 @@ struct bl702_emac_priv {
 
     struct clk *emac_clk; // EMAC core clock
     struct clk *mii_clk;  // MII/MDIO clock
-    unsigned int tx_irq_countdown;// packet counter
-    ktime_t last_tx_irq_time; // last irq time
+    // Ring geometry (ethtool -G), TX BDs come first in BD memory, RX BDs follow
+    unsigned int tx_ring_size;
+    unsigned int rx_ring_size;
+    // A failed ring rebuild left the device running without rings, NAPI disabled
+    // and the MAC stopped. Cleared by the next successful init_hw().
+    bool rings_down;
+
     // TX Ring
-    struct sk_buff *tx_skb[EMAC_TX_BD_BUM_MAX]; // Array to hold skb pointers
-    dma_addr_t tx_skb_dma_addr[EMAC_TX_BD_BUM_MAX]; // DMA addresses of skbs
-    unsigned int tx_head; // Next BD to hand to hardware
-    unsigned int tx_tail; // Next BD to free after hardware done
-    size_t tx_skb_dma_len[EMAC_TX_BD_BUM_MAX];// To hold mapping length for unmapping
-
-    // RX Ring
-    struct sk_buff *rx_skb[EMAC_RX_BD_BUM_MAX]; // Array to hold skb pointers
-    dma_addr_t rx_skb_dma_addr[EMAC_RX_BD_BUM_MAX]; // DMA addresses of skbs
+    struct bl702_emac_tx_entry tx_ring[BL702_BD_TOTAL];
+    unsigned int tx_stop_thresh; // Queue stops below this many free BDs, the most one skb may use
+    char *tso_hdrs; // TSO_HEADER_SIZE bytes per TX BD, for segment headers built by the driver
+    dma_addr_t tso_hdrs_dma;
+
+    // TX producer, written under the xmit lock by start_xmit and the XDP TX paths.
+    // The consumer index is written by NAPI on another hart, so each gets a line.
+    unsigned int tx_head ____cacheline_aligned_in_smp; // Next BD to hand to hardware
+    unsigned int tx_frames_since_irq; // See bl702_emac_tx_want_irq()
+
+    // TX consumer, written by NAPI
+    unsigned int tx_tail ____cacheline_aligned_in_smp; // Next BD to free after hardware done
+    bool tx_err_pending; // TXE seen, the next cleanup reads the BD status words
+
+    // RX Ring (one page_pool page per BD, recycled instead of reallocated), NAPI only
     unsigned int rx_head; // Next BD to hand to software
     unsigned int rx_tail; // Next BD to fill for hardware
-    size_t rx_skb_dma_len[EMAC_RX_BD_BUM_MAX];// To hold mapping length for unmapping
+    struct bl702_emac_rx_entry rx_ring[BL702_BD_TOTAL];
+    struct page_pool *page_pool;
+    unsigned int rx_buf_len; // Bytes the hardware may write into a page, also EMAC_PACKETLEN MAXFL
+    unsigned int rx_page_order; // RX pages are PAGE_SIZE << rx_page_order, above 0 only for jumbo MTUs
+    unsigned int rx_truesize;
+    u32 rx_copybreak; // Copy frames below this length, set through ethtool --set-tunable
+
+    // XDP
+    struct bpf_prog *xdp_prog;
+    struct xdp_rxq_info xdp_rxq;
+    bool rx_xdp_redirected; // Set by NAPI, xdp_do_flush() at the end of the poll
+
+    // AF_XDP zero-copy (XDP_SETUP_XSK_POOL). xsk_bound is the pool bound to queue 0,
+    // init_hw() builds the rings from it and records it in xsk_pool until deinit_hw()
+    struct xsk_buff_pool *xsk_bound;
+    struct xsk_buff_pool *xsk_pool; // UMEM the rings hold frames of, NULL for page_pool rings
 
     // NAPI
     struct napi_struct napi;
 
+    // Interrupt coalescing (ethtool -C)
+    u32 tx_coal_frames;
+    u32 tx_coal_usecs;
+    u32 rx_coal_frames;
+    u32 rx_coal_usecs;
+    struct hrtimer tx_coal_timer; // Reclaims TX frames sent without an interrupt request
+    struct hrtimer rx_coal_timer; // Ends the interrupt holdoff after a busy NAPI cycle
+    bool rx_dim_enabled; // ethtool -C adaptive-rx, net_dim picks rx-usecs/rx-frames
+    struct dim rx_dim;
+    u16 rx_dim_events; // Completed NAPI cycles, one per interrupt taken
+
+    // Statistics, read through bl702_emac_get_stats64() and ethtool -S
+    struct bl702_emac_napi_stats napi_stats[BL702_NUM_QUEUES];
+    struct bl702_emac_xmit_stats xmit_stats[BL702_NUM_QUEUES];
+    struct bl702_emac_irq_stats irq_stats;
+
     // PHY Link
     struct phylink *phylink;
     struct phylink_config phylink_config;
-    unsigned int link_an_modstatic bool bl702_rx_pending(struct bl702_emac_priv *priv)
-{
-	unsigned int entry;
-	u32 status;
-	entry = NEXT_INDEX(priv->rx_tail, EMAC_RX_BD_BUM_MAX);
-	status = bl702_emac_read_bd_word(priv, entry, false, 0)
-	
-	rmb();  // Make sure DMA writes are visible
-
-	return (status & ~EMAC_BD_RX_E_MASK);  // Adjust this based on your descriptor
-}
-e;
+    unsigned int link_an_mode;
     int link_speed;
     int link_duplex;
     bool link_is_up;
 
     // MAC Address
     u8 mac_addr[ETH_ALEN];
+
+    // BL702_EMAC_SIM, register file of the host-side model instead of MMIO
+    const struct bl702_emac_sim_pdata *sim;
+
+    // BL702_MMIO_STATS
+    atomic_long_t mmio_reads;
+    atomic_long_t mmio_writes;
 };
 
 // --- Helper Functions for Register Access ---
 
 static inline u32 bl702_emac_readl(struct bl702_emac_priv *priv, unsigned long offset)
 {
+    if (BL702_MMIO_STATS)
+        atomic_long_inc(&priv->mmio_reads);
+    if (BL702_EMAC_SIM && priv->sim)
+        return priv->sim->readl(priv->sim->ctx, offset);
     return readl(priv->base_addr + offset);
 }
 
 static inline void bl702_emac_writel(struct bl702_emac_priv *priv, u32 val, unsigned long offset)
 {
-    writel(val, priv->base_addr + offset);
+    if (BL702_MMIO_STATS)
+        atomic_long_inc(&priv->mmio_writes);
+    if (BL702_EMAC_SIM && priv->sim)
+        priv->sim->writel(priv->sim->ctx, val, offset);
+    else
+        writel(val, priv->base_addr + offset);
 }
 
 // Helper to write to internal BD
@@ -104,7 +302,7 @@ static inline void bl702_emac_write_bd_word(struct bl702_emac_priv *priv, unsign
 
     if (!is_tx) {
         // RX BDs come after TX BDs in the internal memory
-        bd_base_offset += (EMAC_TX_BD_BUM_MAX * 8); // Each BD is 8 bytes
+        bd_base_offset += (priv->tx_ring_size * 8); // Each BD is 8 bytes
     }
 
     offset = bd_base_offset + (bd_idx * 8) + word_offset; // word_offset is 0 for word0, 4 for word1
@@ -119,13 +317,27 @@ static inline u32 bl702_emac_read_bd_word(struct bl702_emac_priv *priv, unsigned
     unsigned long offset;
 
     if (!is_tx) {
-        bd_base_offset += (EMAC_TX_BD_BUM_MAX * 8);
+        bd_base_offset += (priv->tx_ring_size * 8);
     }
 
     offset = bd_base_offset + (bd_idx * 8) + word_offset;
     return bl702_emac_readl(priv, offset);
 }
 
+static void bl702_emac_tx_unmap(struct bl702_emac_priv *priv, unsigned int entry)
+{
+    struct bl702_emac_tx_entry *e = &priv->tx_ring[entry];
+
+    if (!e->dma_len)
+        return;
+
+    if (e->dma_page)
+        dma_unmap_page(priv->dev, e->dma_addr, e->dma_len, DMA_TO_DEVICE);
+    else
+        dma_unmap_single(priv->dev, e->dma_addr, e->dma_len, DMA_TO_DEVICE);
+    e->dma_len = 0;
+}
+
 
 // --- PHY/MII/MDIO Helper Functions ---
 // These are simplified and assume phylink handles much of the complexity.
@@ -169,7 +381,7 @@ static int bl702_emac_mdio_write(struct bl702_emac_priv *priv, int phy_addr, int
     regval = FIELD_PREP(EMAC_CTRLDATA_MASK, val);
     bl702_emac_writel(priv, regval, EMAC_MIITX_DATA_OFFSET);
 
-    bl702_emac_writel(priv->base_addr, EMAC_WCTRLDATA, EMAC_MIICOMMAND_OFFSET); // Start write
+    bl702_emac_writel(priv, EMAC_WCTRLDATA, EMAC_MIICOMMAND_OFFSET); // Start write
 
     // Wait for MII busy to clear
     ret = readx_poll_timeout(bl702_emac_readl, priv, regval, !(regval & EMAC_MIIM_BUSY),
@@ -228,7 +440,9 @@ static void bl702_emac_mac_link_state(struct phylink_config *config,
         pr_info("%s: Link is UP - %s/%s\n", netdev->name,
                 phy_speed_to_str(state->speed),
                 phy_duplex_to_str(state->duplex));
-        netif_start_queue(netdev);
+        // No rings to transmit into after a failed rebuild
+        if (!priv->rings_down)
+            netif_start_queue(netdev);
         priv->link_is_up = true;
     } else if (!state->link && priv->link_is_up) {
         pr_info("%s: Link is DOWN\n", netdev->name);
@@ -243,40 +457,247 @@ static const struct phylink_mac_ops bl702_emac_phylink_ops = {
     // .mac_an_restart, .mac_link_up, .mac_link_down could be added if needed
 };
 
+// --- RX Buffer Helpers ---
+
+// Point an RX BD at a buffer and give the BD back to the hardware
+static void bl702_emac_arm_rx_bd_dma(struct bl702_emac_priv *priv, unsigned int entry,
+                                     dma_addr_t dma_addr)
+{
+    u32 attr_len_word = EMAC_BD_RX_E | EMAC_BD_RX_IRQ;
+
+    bl702_emac_write_bd_word(priv, entry, false, 4, dma_addr);
+    if (entry == (priv->rx_ring_size - 1)) {
+        attr_len_word |= EMAC_BD_RX_WR;
+    }
+    dma_wmb(); // Address must be in place before the BD is marked empty
+    bl702_emac_write_bd_word(priv, entry, false, 0, attr_len_word);
+}
+
+// Point an RX BD at the page stored for it
+static void bl702_emac_arm_rx_bd(struct bl702_emac_priv *priv, unsigned int entry)
+{
+    bl702_emac_arm_rx_bd_dma(priv, entry,
+                             page_pool_get_dma_addr(priv->rx_ring[entry].page) + BL702_RX_HEADROOM);
+}
+
+// Take a recycled (already DMA mapped) page from the pool for an RX BD
+static int bl702_emac_alloc_rx_page(struct bl702_emac_priv *priv, unsigned int entry)
+{
+    struct page *page = page_pool_dev_alloc_pages(priv->page_pool);
+
+    if (!page)
+        return -ENOMEM;
+
+    priv->rx_ring[entry].page = page;
+    bl702_emac_arm_rx_bd(priv, entry);
+    return 0;
+}
+
+// Copy a small frame out so its mapped page can go straight back to the hardware
+static struct sk_buff *bl702_emac_rx_copy(struct bl702_emac_priv *priv, struct napi_struct *napi,
+                                          struct page *page, u32 rx_len)
+{
+    dma_addr_t dma_addr = page_pool_get_dma_addr(page) + BL702_RX_HEADROOM;
+    struct sk_buff *skb = napi_alloc_skb(napi, rx_len);
+
+    if (!skb)
+        return NULL;
+
+    dma_sync_single_for_cpu(priv->dev, dma_addr, rx_len, page_pool_get_dma_dir(priv->page_pool));
+    skb_put_data(skb, page_address(page) + BL702_RX_HEADROOM, rx_len);
+    dma_sync_single_for_device(priv->dev, dma_addr, rx_len, page_pool_get_dma_dir(priv->page_pool));
+    return skb;
+}
+
+static int bl702_emac_create_page_pool(struct bl702_emac_priv *priv)
+{
+    struct page_pool_params pp_params = {
+        .flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV,
+        .order = priv->rx_page_order,
+        .pool_size = priv->rx_ring_size,
+        .nid = NUMA_NO_NODE,
+        .dev = priv->dev,
+        .napi = &priv->napi,
+        // XDP_TX sends RX pages as they are, the device then reads them too
+        .dma_dir = priv->xdp_prog ? DMA_BIDIRECTIONAL : DMA_FROM_DEVICE,
+        .offset = BL702_RX_HEADROOM,
+        .max_len = priv->rx_buf_len,
+    };
+
+    int ret;
+
+    priv->page_pool = page_pool_create(&pp_params);
+    if (IS_ERR(priv->page_pool)) {
+        ret = PTR_ERR(priv->page_pool);
+        priv->page_pool = NULL;
+        return ret;
+    }
+
+    // XDP frames carry the pool with them, so redirect targets can recycle the pages
+    ret = xdp_rxq_info_reg(&priv->xdp_rxq, priv->netdev, 0, priv->napi.napi_id);
+    if (!ret)
+        ret = xdp_rxq_info_reg_mem_model(&priv->xdp_rxq, MEM_TYPE_PAGE_POOL, priv->page_pool);
+    if (ret) {
+        if (xdp_rxq_info_is_reg(&priv->xdp_rxq))
+            xdp_rxq_info_unreg(&priv->xdp_rxq);
+        page_pool_destroy(priv->page_pool);
+        priv->page_pool = NULL;
+    }
+    return ret;
+}
+
+static void bl702_emac_free_rx_ring(struct bl702_emac_priv *priv)
+{
+    int i;
+
+    for (i = 0; i < priv->rx_ring_size; i++) {
+        if (priv->rx_ring[i].page) {
+            page_pool_put_full_page(priv->page_pool, priv->rx_ring[i].page, false);
+            priv->rx_ring[i].page = NULL;
+        }
+        if (priv->rx_ring[i].xsk) {
+            xsk_buff_free(priv->rx_ring[i].xsk);
+            priv->rx_ring[i].xsk = NULL;
+        }
+    }
+    if (xdp_rxq_info_is_reg(&priv->xdp_rxq))
+        xdp_rxq_info_unreg(&priv->xdp_rxq);
+    if (priv->page_pool) {
+        page_pool_destroy(priv->page_pool);
+        priv->page_pool = NULL;
+    }
+}
+
+// Arm the RX BDs left without a UMEM frame, from rx_tail on. Returns false when the
+// fill ring ran dry before every BD had a frame.
+static bool bl702_emac_xsk_refill(struct bl702_emac_priv *priv)
+{
+    struct xdp_buff *xdp;
+
+    while (!priv->rx_ring[priv->rx_tail].xsk) {
+        xdp = xsk_buff_alloc(priv->xsk_pool);
+        if (!xdp)
+            return false;
+
+        priv->rx_ring[priv->rx_tail].xsk = xdp;
+        bl702_emac_arm_rx_bd_dma(priv, priv->rx_tail, xsk_buff_xdp_get_dma(xdp));
+        priv->rx_tail = NEXT_INDEX(priv->rx_tail, priv->rx_ring_size);
+    }
+    return true;
+}
+
+// AF_XDP zero-copy RX ring, every BD takes a UMEM frame from the fill ring. User space
+// may not have filled it yet: the BDs are cleared first so the MAC stops at the ones
+// still without a frame, bl702_emac_xsk_refill() arms them from NAPI later.
+static int bl702_emac_xsk_init_rx(struct bl702_emac_priv *priv)
+{
+    int i, ret;
+
+    ret = xdp_rxq_info_reg(&priv->xdp_rxq, priv->netdev, 0, priv->napi.napi_id);
+    if (!ret)
+        ret = xdp_rxq_info_reg_mem_model(&priv->xdp_rxq, MEM_TYPE_XSK_BUFF_POOL, NULL);
+    if (ret) {
+        if (xdp_rxq_info_is_reg(&priv->xdp_rxq))
+            xdp_rxq_info_unreg(&priv->xdp_rxq);
+        return ret;
+    }
+    xsk_pool_set_rxq_info(priv->xsk_pool, &priv->xdp_rxq);
+
+    for (i = 0; i < priv->rx_ring_size; i++)
+        bl702_emac_write_bd_word(priv, i, false, 0,
+                                 i == priv->rx_ring_size - 1 ? EMAC_BD_RX_WR : 0);
+    bl702_emac_xsk_refill(priv);
+    return 0;
+}
+
 // --- EMAC Core Operations ---
 
-static void bl702_emac_init_hw(struct bl702_emac_priv *priv)
+// Largest frame the MAC accepts for an MTU: VLAN tagged, FCS included
+static unsigned int bl702_emac_rx_buf_len(unsigned int mtu)
+{
+    return mtu + VLAN_ETH_HLEN + ETH_FCS_LEN;
+}
+
+// Every RX page must hold headroom + frame + skb_shared_info so build_skb can wrap it in place
+static unsigned int bl702_emac_rx_page_order(unsigned int mtu)
+{
+    return get_order(BL702_RX_HEADROOM + bl702_emac_rx_buf_len(mtu) +
+                     SKB_DATA_ALIGN(sizeof(struct skb_shared_info)));
+}
+
+// Program promiscuous mode and the 64-bit multicast hash filter. The MAC takes the
+// top 6 bits of the Ethernet CRC of a multicast destination as the bit index into
+// HASH1:HASH0 and drops the frame in hardware when that bit is clear.
+static void bl702_emac_set_rx_mode(struct net_device *netdev)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+    struct netdev_hw_addr *ha;
+    u32 hash[2] = { 0, 0 };
+    u32 regval;
+
+    if (netdev->flags & (IFF_PROMISC | IFF_ALLMULTI)) {
+        hash[0] = 0xFFFFFFFF;
+        hash[1] = 0xFFFFFFFF;
+    } else {
+        netdev_for_each_mc_addr(ha, netdev) {
+            u32 bit = ether_crc(ETH_ALEN, ha->addr) >> 26;
+
+            hash[bit >> 5] |= BIT(bit & 31);
+        }
+    }
+    bl702_emac_writel(priv, hash[0], EMAC_HASH0_ADDR_OFFSET);
+    bl702_emac_writel(priv, hash[1], EMAC_HASH1_ADDR_OFFSET);
+
+    regval = bl702_emac_readl(priv, EMAC_MODE_OFFSET);
+    if (netdev->flags & IFF_PROMISC)
+        regval |= EMAC_PRO;
+    else
+        regval &= ~EMAC_PRO;
+    bl702_emac_writel(priv, regval, EMAC_MODE_OFFSET);
+}
+
+static int bl702_emac_init_hw(struct bl702_emac_priv *priv)
 {
     u32 regval;
     int i;
 
+    priv->rx_buf_len = bl702_emac_rx_buf_len(priv->netdev->mtu);
+    priv->rx_page_order = bl702_emac_rx_page_order(priv->netdev->mtu);
+    priv->rx_truesize = PAGE_SIZE << priv->rx_page_order;
+
     // Configure EMAC Mode 
-    // Enable CRC, PAD, Huge Frame, Receive Small Frame
-    regval = EMAC_CRCEN | EMAC_PAD | EMAC_HUGEN | EMAC_RECSMALL;
-    // Set MII mode by default
-    regval |= ~EMAC_RMII_EN;
+    // Enable CRC, PAD, Receive Small Frame. Huge frames stay off: MAXFL is what keeps
+    // a frame inside its RX page
+    regval = EMAC_CRCEN | EMAC_PAD | EMAC_RECSMALL;
+    // Keep the duplex and MII/RMII mode phylink applied when the rings are rebuilt
+    regval |= bl702_emac_readl(priv, EMAC_MODE_OFFSET) & (EMAC_FULLD | EMAC_RMII_EN);
     // Enable broadcast by default
     regval |= EMAC_BRO;
     bl702_emac_writel(priv, regval, EMAC_MODE_OFFSET);
 
     // Set MAC Address
-    // MAC_ADDR0 (bytes 2,3,4,5)
-    regval = priv->mac_addr[2] |
-             (priv->mac_addr[3] << 8) |
-             (priv->mac_addr[4] << 16) |
-             (priv->mac_addr[5] << 24);
+    // MAC_ADDR0 (bytes 2,3,4,5), byte 5 in the low bits
+    regval = ((u32)priv->mac_addr[2] << EMAC_MAC_B2_SHIFT) |
+             ((u32)priv->mac_addr[3] << EMAC_MAC_B3_SHIFT) |
+             ((u32)priv->mac_addr[4] << EMAC_MAC_B4_SHIFT) |
+             ((u32)priv->mac_addr[5] << EMAC_MAC_B5_SHIFT);
     bl702_emac_writel(priv, regval, EMAC_MAC_ADDR0_OFFSET);
 
-    // MAC_ADDR1 (bytes 0,1)
-    regval = priv->mac_addr[0] |
-             (priv->mac_addr[1] << 8);
+    // MAC_ADDR1 (bytes 0,1), byte 1 in the low bits
+    regval = ((u32)priv->mac_addr[0] << EMAC_MAC_B0_SHIFT) |
+             ((u32)priv->mac_addr[1] << EMAC_MAC_B1_SHIFT);
     bl702_emac_writel(priv, regval, EMAC_MAC_ADDR1_OFFSET);
 
+    // Promiscuous mode and multicast filter
+    netif_addr_lock_bh(priv->netdev);
+    bl702_emac_set_rx_mode(priv->netdev);
+    netif_addr_unlock_bh(priv->netdev);
+
     // Configure Packet Lengths
     // Max/Min frame length
     //regval = FIELD_PREP(EMAC_MAXFL_MASK, priv->netdev->mtu + ETH_HLEN + ETH_FCS_LEN); // MTU + Eth Header + FCS
     //regval |= FIELD_PREP(EMAC_MINFL_MASK, ETH_ZLEN); // Minimum Ethernet frame length
-    regval = FIELD_PREP(EMAC_MAXFL_MASK, ETH_MAXFL); // Maximum Ethernet frame length
+    regval = FIELD_PREP(EMAC_MAXFL_MASK, priv->rx_buf_len); // Maximum frame for the MTU
     regval |= FIELD_PREP(EMAC_MINFL_MASK, ETH_MINFL); // Minimum Ethernet frame length
 
     bl702_emac_writel(priv, regval, EMAC_PACKETLEN_OFFSET);
@@ -287,7 +708,11 @@ static void bl702_emac_init_hw(struct bl702_emac_priv *priv)
     bl702_emac_writel(priv, regval, EMAC_MIIMODE_OFFSET);
 
     // 6. Initialize TX Descriptors (in EMAC's internal memory)
-    for (i = 0; i < EMAC_TX_BD_BUM_MAX; i++) {
+    // The TX BD count also places the RX BDs, they start right after the last TX BD
+    regval = FIELD_PREP(EMAC_TXBDNUM_MASK, priv->tx_ring_size);
+    bl702_emac_writel(priv, regval, EMAC_TX_BD_NUM_OFFSET);
+
+    for (i = 0; i < priv->tx_ring_size; i++) {
         // Clear descriptor (Word 0 & Word 1)
         bl702_emac_write_bd_word(priv, i, true, 0, 0); // attribute + length word
         bl702_emac_write_bd_word(priv, i, true, 4, 0); // address word
@@ -314,7 +739,7 @@ static void bl702_emac_init_hw(struct bl702_emac_priv *priv)
         bl702_emac_write_bd_word(priv, i, true, 4, priv->tx_skb_dma_addr[i]);
 	*/
         // Set Wrap bit for the last BD
-        if (i == (EMAC_TX_BD_BUM_MAX - 1)) {
+        if (i == (priv->tx_ring_size - 1)) {
             u32 attr_len_word = bl702_emac_read_bd_word(priv, i, true, 0);
             attr_len_word |= EMAC_BD_TX_WR;
             bl702_emac_write_bd_word(priv, i, true, 0, attr_len_word);
@@ -322,78 +747,57 @@ static void bl702_emac_init_hw(struct bl702_emac_priv *priv)
     }
     priv->tx_head = 0;
     priv->tx_tail = 0;
-
-    // 7. Initialize RX Descriptors (in EMAC's internal memory)
-    for (i = 0; i < EMAC_RX_BD_BUM_MAX; i++) {
-        // Clear descriptor (Word 0 & Word 1)
-        bl702_emac_write_bd_word(priv, i, false, 0, 0); // attribute + length word
-        bl702_emac_write_bd_word(priv, i, false, 4, 0); // address word
-
-        // Allocate skb for RX
-        priv->rx_skb[i] = netdev_alloc_skb(priv->netdev, priv->netdev->mtu + ETH_HLEN + ETH_FCS_LEN + NET_IP_ALIGN);
-        if (!priv->rx_skb[i]) {
-            dev_err(priv->dev, "Failed to allocate RX skb %d\n", i);
-            // Handle error: free previously allocated skbs and exit
-            goto err_rx_skb;
-        }
-        skb_reserve(priv->rx_skb[i], NET_IP_ALIGN); // Align data for IP header
-	priv->rx_skb_dma_len[i] = priv->netdev->mtu + ETH_HLEN + ETH_FCS_LEN;
-        // Map the SKB data buffer for DMA
-        priv->rx_skb_dma_addr[i] = dma_map_single(priv->dev, priv->rx_skb[i]->data,
-                                                   priv->rx_skb_dma_len[i],
-                                                   DMA_FROM_DEVICE);
-        if (dma_mapping_error(priv->dev, priv->rx_skb_dma_addr[i])) {
-            dev_err(priv->dev, "Failed to map RX skb %d for DMA\n", i);
-            kfree_skb(priv->rx_skb[i]);
-            priv->rx_skb[i] = NULL;
-            // Handle error
-            goto err_rx_dma;
+    // A linearized jumbo frame still takes one BD per EMAC_TX_BD_BUF_SIZE bytes, a
+    // one segment TSO skb one more for its header. Larger TSO skbs are held to the
+    // threshold by bl702_emac_features_check().
+    priv->tx_stop_thresh = max_t(unsigned int, BL702_TX_MAX_DESC,
+                                 1 + DIV_ROUND_UP(priv->rx_buf_len, EMAC_TX_BD_BUF_SIZE));
+    priv->tx_stop_thresh = max_t(unsigned int, priv->tx_stop_thresh,
+                                 priv->tx_ring_size / BL702_TSO_RING_DIV);
+
+    // 7. Initialize RX Descriptors (in EMAC's internal memory), from UMEM frames
+    //    while an AF_XDP socket is bound, from the page pool otherwise
+    priv->rx_head = 0;
+    priv->rx_tail = 0;
+    priv->xsk_pool = priv->xsk_bound;
+    if (priv->xsk_pool) {
+        if (bl702_emac_xsk_init_rx(priv)) {
+            dev_err(priv->dev, "Failed to register the AF_XDP RX queue\n");
+            return -ENOMEM;
         }
+        return 0;
+    }
 
-        // Write the DMA address to the internal BD (Word 1)
-        bl702_emac_write_bd_word(priv, i, false, 4, priv->rx_skb_dma_addr[i]);
+    if (bl702_emac_create_page_pool(priv)) {
+        dev_err(priv->dev, "Failed to create RX page pool\n");
+        return -ENOMEM;
+    }
 
-        // Set attribute: Empty, Interrupt, and Wrap for last BD
-        u32 attr_len_word = EMAC_BD_RX_E | EMAC_BD_RX_IRQ;
-        if (i == (EMAC_RX_BD_BUM_MAX - 1)) {
-            attr_len_word |= EMAC_BD_RX_WR;
+    for (i = 0; i < priv->rx_ring_size; i++) {
+        if (bl702_emac_alloc_rx_page(priv, i)) {
+            dev_err(priv->dev, "Failed to allocate RX page %d\n", i);
+            bl702_emac_free_rx_ring(priv);
+            return -ENOMEM;
         }
-        bl702_emac_write_bd_word(priv, i, false, 0, attr_len_word);
     }
-    priv->rx_head = 0;
-    priv->rx_tail = 0;
 
     // 8. Enable TX/RX
     // Don't enable yet, will be done in netdev_open after phylink config.
-    return;
-
-err_rx_dma:
-    for (i--; i >= 0; i--) {
-        if (priv->rx_skb[i]) {
-            dma_unmap_single(priv->dev, priv->rx_skb_dma_addr[i],
-                             priv->netdev->mtu + ETH_HLEN + ETH_FCS_LEN, DMA_FROM_DEVICE);
-            kfree_skb(priv->rx_skb[i]);
-        }
-    }
-err_rx_skb:
-err_tx_dma:
-    for (i = EMAC_TX_BD_BUM_MAX - 1; i >= 0; i--) {
-        if (priv->tx_skb[i]) {
-            dma_unmap_single(priv->dev, priv->tx_skb_dma_addr[i],
-                             priv->netdev->mtu + ETH_HLEN + ETH_FCS_LEN, DMA_TO_DEVICE);
-            kfree_skb(priv->tx_skb[i]);
-        }
-    }
-err_tx_skb:
-    // More robust cleanup needed here for a production driver
-    return; // Indicate failure
+    priv->rings_down = false;
+    return 0;
 }
 
 static void bl702_emac_deinit_hw(struct bl702_emac_priv *priv)
 {
+    unsigned int xsk_frames = 0;
     int i;
+    u32 regval;
+
+    // A failed rebuild already freed the rings
+    if (priv->rings_down)
+        return;
     // Disable EMAC TX/RX
-    u32 regval = bl702_emac_readl(priv, EMAC_MODE_OFFSET);
+    regval = bl702_emac_readl(priv, EMAC_MODE_OFFSET);
     regval &= ~(EMAC_TX_EN | EMAC_RX_EN);
     bl702_emac_writel(priv, regval, EMAC_MODE_OFFSET);
 
@@ -401,33 +805,84 @@ static void bl702_emac_deinit_hw(struct bl702_emac_priv *priv)
     bl702_emac_writel(priv, 0xFFFFFFFF, EMAC_INT_SOURCE_OFFSET); // Clear all pending
 
     // Unmap and free SKBs and DMA resources
-    for (i = 0; i < EMAC_TX_BD_BUM_MAX; i++) {
-        if (priv->tx_skb[i]) {
-            dma_unmap_single(priv->dev, priv->tx_skb_dma_addr[i],
-                             priv->netdev->mtu + ETH_HLEN + ETH_FCS_LEN, DMA_TO_DEVICE);
-            kfree_skb(priv->tx_skb[i]);
-            priv->tx_skb[i] = NULL;
+    for (i = 0; i < priv->tx_ring_size; i++) {
+        bl702_emac_tx_unmap(priv, i);
+        if (priv->tx_ring[i].skb) {
+            dev_kfree_skb_any(priv->tx_ring[i].skb);
+            priv->tx_ring[i].skb = NULL;
         }
-    }
-    for (i = 0; i < EMAC_RX_BD_BUM_MAX; i++) {
-        if (priv->rx_skb[i]) {
-            dma_unmap_single(priv->dev, priv->rx_skb_dma_addr[i],
-                             priv->netdev->mtu + ETH_HLEN + ETH_FCS_LEN, DMA_FROM_DEVICE);
-            kfree_skb(priv->rx_skb[i]);
-            priv->rx_skb[i] = NULL;
+        if (priv->tx_ring[i].xdpf) {
+            xdp_return_frame(priv->tx_ring[i].xdpf);
+            priv->tx_ring[i].xdpf = NULL;
+        }
+        if (priv->tx_ring[i].xsk) {
+            xsk_frames++;
+            priv->tx_ring[i].xsk = false;
         }
     }
+    // Descriptors still in flight go back to the socket's completion ring
+    if (xsk_frames)
+        xsk_tx_completed(priv->xsk_pool, xsk_frames);
+    netdev_reset_queue(priv->netdev);
+    bl702_emac_free_rx_ring(priv);
+    priv->xsk_pool = NULL;
 }
 
 // --- Netdev Operations ---
 
+static irqreturn_t bl702_emac_irq(int irq, void *dev_id);
+
+// Enable NAPI, the MAC and its interrupts once the rings are initialized
+static void bl702_emac_start_datapath(struct bl702_emac_priv *priv)
+{
+    u32 regval;
+
+    napi_enable(&priv->napi);
+
+    regval = bl702_emac_readl(priv, EMAC_MODE_OFFSET);
+    regval |= (EMAC_TX_EN | EMAC_RX_EN);
+    bl702_emac_writel(priv, regval, EMAC_MODE_OFFSET);
+
+    // Mask in the INT_MASK register means "enable"
+    bl702_emac_writel(priv, BL702_INT_MASK_ALL, EMAC_INT_MASK_OFFSET);
+
+    priv->tx_frames_since_irq = 0;
+    netdev_reset_queue(priv->netdev);
+}
+
+// Quiesce xmit, NAPI, the coalescing timers and the MAC so the rings can be torn down
+static void bl702_emac_stop_datapath(struct bl702_emac_priv *priv)
+{
+    u32 regval;
+
+    // NAPI is still disabled after a failed rebuild
+    if (priv->rings_down)
+        return;
+
+    netif_tx_disable(priv->netdev);
+    napi_disable(&priv->napi);
+    hrtimer_cancel(&priv->tx_coal_timer);
+    hrtimer_cancel(&priv->rx_coal_timer);
+    cancel_work_sync(&priv->rx_dim.work);
+
+    bl702_emac_writel(priv, 0, EMAC_INT_MASK_OFFSET);
+
+    regval = bl702_emac_readl(priv, EMAC_MODE_OFFSET);
+    regval &= ~(EMAC_TX_EN | EMAC_RX_EN);
+    bl702_emac_writel(priv, regval, EMAC_MODE_OFFSET);
+}
+
 static int bl702_emac_open(struct net_device *netdev)
 {
     struct bl702_emac_priv *priv = netdev_priv(netdev);
     int ret;
-    u32 regval;
 
-    bl702_emac_init_hw(priv);
+    ret = bl702_emac_init_hw(priv);
+    if (ret) {
+        clk_disable_unprepare(priv->mii_clk);
+        clk_disable_unprepare(priv->emac_clk);
+        return ret;
+    }
 
     // 2. Request IRQ
     ret = request_irq(netdev->irq, bl702_emac_irq, 0, netdev->name, netdev);
@@ -439,21 +894,10 @@ static int bl702_emac_open(struct net_device *netdev)
         return ret;
     }
 
-    // 3. Enable NAPI
-    napi_enable(&priv->napi);
-
-    // 5. Enable EMAC TX/RX
-    regval = bl702_emac_readl(priv, EMAC_MODE_OFFSET);
-    regval |= (EMAC_TX_EN | EMAC_RX_EN);
-    bl702_emac_writel(priv, regval, EMAC_MODE_OFFSET);
-
-    // 6. Enable all EMAC interrupts (TXB, TXE, RXB, RXE, BUSY, TXC, RXC)
-    // Mask in the INT_MASK register means "enable"
-    bl702_emac_writel(priv, EMAC_TXB_M | EMAC_TXE_M | EMAC_RXB_M | EMAC_RXE_M |
-                              EMAC_BUSY_M | EMAC_TXC_M | EMAC_RXC_M,
-                      EMAC_INT_MASK_OFFSET);
+    // 3. Enable NAPI, EMAC TX/RX and all EMAC interrupts (TXB, TXE, RXB, RXE, BUSY, TXC, RXC)
+    bl702_emac_start_datapath(priv);
 
-    // 7. Start the network queue
+    // 4. Start the network queue
     netif_start_queue(netdev); // netif_start_queue can be deferred until link up by phylink_mac_link_state
 
     return 0;
@@ -462,29 +906,18 @@ static int bl702_emac_open(struct net_device *netdev)
 static int bl702_emac_stop(struct net_device *netdev)
 {
     struct bl702_emac_priv *priv = netdev_priv(netdev);
-    u32 regval;
-
-    // 1. Stop the network queue
-    netif_stop_queue(netdev);
-
-    // 2. Disable all EMAC interrupts
-    bl702_emac_writel(priv, 0, EMAC_INT_MASK_OFFSET);
-
-    // 3. Disable EMAC TX/RX
-    regval = bl702_emac_readl(priv, EMAC_MODE_OFFSET);
-    regval &= ~(EMAC_TX_EN | EMAC_RX_EN);
-    bl702_emac_writel(priv, regval, EMAC_MODE_OFFSET);
 
-    // 4. Stop PHY link via phylink
-    phylink_stop(priv->phylink);
+    // 1. Stop the queue, NAPI, interrupts and EMAC TX/RX
+    bl702_emac_stop_datapath(priv);
 
-    // 5. Disable NAPI
-    napi_disable(&priv->napi);
+    // 2. Stop PHY link via phylink
+    if (priv->phylink)
+        phylink_stop(priv->phylink);
 
-    // 6. Free IRQ
+    // 3. Free IRQ
     free_irq(netdev->irq, netdev);
 
-    // 7. De-initialize hardware (free buffers, disable clocks)
+    // 4. De-initialize hardware (free buffers, disable clocks)
     bl702_emac_deinit_hw(priv);
 
     clk_disable_unprepare(priv->mii_clk);
@@ -492,6 +925,68 @@ static int bl702_emac_stop(struct net_device *netdev)
 
     return 0;
 }
+
+// Rebuild both rings with a new geometry and MTU, called under RTNL
+static int bl702_emac_reconfigure_rings(struct net_device *netdev, unsigned int tx_size,
+                                        unsigned int rx_size, unsigned int mtu)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+    unsigned int old_tx_size = priv->tx_ring_size, old_rx_size = priv->rx_ring_size;
+    unsigned int old_mtu = netdev->mtu;
+    int ret;
+
+    if (!netif_running(netdev)) {
+        priv->tx_ring_size = tx_size;
+        priv->rx_ring_size = rx_size;
+        WRITE_ONCE(netdev->mtu, mtu);
+        return 0;
+    }
+
+    bl702_emac_stop_datapath(priv);
+    bl702_emac_deinit_hw(priv);
+
+    priv->tx_ring_size = tx_size;
+    priv->rx_ring_size = rx_size;
+    WRITE_ONCE(netdev->mtu, mtu);
+    ret = bl702_emac_init_hw(priv);
+    if (ret) {
+        // Fall back to the old geometry and MTU so the interface keeps working,
+        // higher order pages for a larger MTU may simply not be available
+        priv->tx_ring_size = old_tx_size;
+        priv->rx_ring_size = old_rx_size;
+        WRITE_ONCE(netdev->mtu, old_mtu);
+        if (bl702_emac_init_hw(priv)) {
+            // ndo_stop and the next rebuild skip the teardown that already happened
+            priv->rings_down = true;
+            netdev_err(netdev, "Failed to restore rings, interface is down\n");
+            return ret;
+        }
+    }
+
+    bl702_emac_start_datapath(priv);
+    netif_wake_queue(netdev);
+    return ret;
+}
+
+// MTU changes resize the RX pages and MAXFL, a running interface rebuilds its rings
+static int bl702_emac_change_mtu(struct net_device *netdev, int new_mtu)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+
+    if (priv->xdp_prog && bl702_emac_rx_page_order(new_mtu)) {
+        netdev_err(netdev, "MTU %d too large while an XDP program is attached\n", new_mtu);
+        return -EINVAL;
+    }
+    if (priv->xsk_bound &&
+        xsk_pool_get_rx_frame_size(priv->xsk_bound) < bl702_emac_rx_buf_len(new_mtu)) {
+        netdev_err(netdev, "MTU %d does not fit the AF_XDP frame size\n", new_mtu);
+        return -EINVAL;
+    }
+
+    // On failure the rings come back at the old MTU
+    return bl702_emac_reconfigure_rings(netdev, priv->tx_ring_size, priv->rx_ring_size, new_mtu);
+}
+
 /* Single descriptor not proper
 static netdev_tx_t bl702_emac_start_xmit(struct sk_buff *skb, struct net_device *netdev)
 {
@@ -567,121 +1062,707 @@ static netdev_tx_t bl702_emac_start_xmit(struct sk_buff *skb, struct net_device
 }*/
 
 
-static netdev_tx_t bl702_emac_start_xmit(struct sk_buff *skb, struct net_device *netdev)
+static inline unsigned int tx_ring_space(unsigned int tx_head, unsigned int tx_tail, unsigned int ring_size)
 {
-    struct bl702_emac_priv *priv = netdev_priv(netdev);
-    unsigned int entry = priv->tx_head;
-    unsigned int i, desc_count = 0, needed_desc = 0;
-    unsigned int len, offset, frag_size, ring_size = EMAC_TX_RING_SIZE;
-    dma_addr_t dma_addr;
-    u32 attr_len_word;
-    const skb_frag_t *frag;
-
-    // 1. Estimate needed descriptors for skb->data
-    len = skb_headlen(skb);
-    needed_desc += DIV_ROUND_UP(len, EMAC_TX_BD_BUF_SIZE);
+    if (tx_tail > tx_head)
+        return tx_tail - tx_head - 1;
+    else
+        return ring_size + tx_tail - tx_head - 1;
+}
 
-    // 2. Estimate needed descriptors for frags
-    for (i = 0; i < skb_shinfo(skb)->nr_frags; i++) {
-        frag_size = skb_frag_size(&skb_shinfo(skb)->frags[i]);
-        needed_desc += DIV_ROUND_UP(frag_size, EMAC_TX_BD_BUF_SIZE);
-    }
+// BDs bl702_emac_tx_map_tso() may use. Every segment takes a header BD and its payload
+// in EMAC_TX_BD_BUF_SIZE pieces, tso_count_descs() would assume one piece per segment.
+// Each boundary between the linear part and the frags can split one more piece off.
+static unsigned int bl702_emac_tso_desc_count(const struct sk_buff *skb)
+{
+    unsigned int gso_size = skb_shinfo(skb)->gso_size;
+    unsigned int payload = skb->len - skb_tcp_all_headers(skb);
+    unsigned int last = payload % gso_size;
+    unsigned int n;
+
+    n = (payload / gso_size) * (1 + DIV_ROUND_UP(gso_size, EMAC_TX_BD_BUF_SIZE));
+    if (last)
+        n += 1 + DIV_ROUND_UP(last, EMAC_TX_BD_BUF_SIZE);
+    return n + skb_shinfo(skb)->nr_frags;
+}
 
-    // 3. Check if enough descriptors are available
-    for (i = 0; i < needed_desc; i++) {
-	    unsigned int idx = (entry + i) % ring_size;
-	    u32 status = bl702_emac_read_bd_word(priv, idx, true, 0);
-	    if (status & EMAC_BD_TX_RD) {
-		netif_stop_queue(netdev);
+static unsigned int bl702_emac_tx_desc_count(const struct sk_buff *skb)
+{
+    unsigned int i, n;
 
-		// Optional: recheck once to avoid false positive
-		smp_rmb();
-		status = bl702_emac_read_bd_word(priv, idx, true, 0);
-		if ((status & EMAC_BD_TX_RD) == 0)
-		    netif_wake_queue(netdev);  // Rare, but helps
+    if (skb_is_gso(skb))
+        return bl702_emac_tso_desc_count(skb);
 
-		return NETDEV_TX_BUSY;
-	    }
-     }
+    n = DIV_ROUND_UP(skb_headlen(skb), EMAC_TX_BD_BUF_SIZE);
+    for (i = 0; i < skb_shinfo(skb)->nr_frags; i++)
+        n += DIV_ROUND_UP(skb_frag_size(&skb_shinfo(skb)->frags[i]), EMAC_TX_BD_BUF_SIZE);
+    return n;
+}
 
-    // 4. Map skb->data
-    len = skb_headlen(skb);
-    offset = 0;
-    while (len) {
-        unsigned int size = min(len, EMAC_TX_BD_BUF_SIZE);
-        dma_addr = dma_map_single(priv->dev, skb->data + offset, size, DMA_TO_DEVICE);
-        if (dma_mapping_error(priv->dev, dma_addr)) {
-            dev_kfree_skb_any(skb);
-            return NETDEV_TX_OK;
-        }
+// BDs queued by one start_xmit call: a frame, or all segments of a TSO skb.
+// The first BD keeps RD clear until the whole batch is queued, the MAC walks
+// BDs in order and stops at one it does not own, so it never starts on a half
+// written batch.
+struct bl702_emac_tx_batch {
+    unsigned int entry; // Next BD to fill
+    unsigned int count; // BDs filled so far
+    u32 first_word;
+    u32 last_word;
+};
 
-        priv->tx_skb_dma_addr[entry] = dma_addr;
-        priv->tx_skb[entry] = (desc_count == 0) ? skb : NULL;  // only first stores skb
-        bl702_emac_write_bd_word(priv, entry, true, 4, dma_addr);
+// Queue one buffer on the next BD, map_len is 0 for TSO headers in the coherent pool
+static void bl702_emac_tx_add_bd(struct bl702_emac_priv *priv, struct bl702_emac_tx_batch *b,
+                                 dma_addr_t dma_addr, unsigned int len, size_t map_len,
+                                 bool is_page, bool eof)
+{
+    unsigned int entry = b->entry;
+    u32 word = FIELD_PREP(EMAC_BD_TX_LEN_MASK, len) | EMAC_BD_TX_CRC | EMAC_BD_TX_PAD | EMAC_BD_TX_RD;
+
+    if (entry == priv->tx_ring_size - 1)
+        word |= EMAC_BD_TX_WR;
+    if (eof)
+        word |= EMAC_BD_TX_EOF_MASK;
+
+    priv->tx_ring[entry] = (struct bl702_emac_tx_entry) {
+        .dma_addr = dma_addr,
+        .dma_len = map_len,
+        .dma_page = is_page,
+    };
+    bl702_emac_write_bd_word(priv, entry, true, 4, dma_addr);
+    if (b->count == 0)
+        b->first_word = word;
+    else
+        bl702_emac_write_bd_word(priv, entry, true, 0, word);
 
-        attr_len_word = FIELD_PREP(EMAC_BD_TX_LEN_MASK, size);
-        if (entry == ring_size - 1)
-            attr_len_word |= EMAC_BD_TX_WR;
-        if (desc_count == needed_desc - 1)
-            attr_len_word |= EMAC_BD_TX_EOF_MASK;  // Final desc: EOF
-        attr_len_word |= EMAC_BD_TX_CRC | EMAC_BD_TX_PAD | EMAC_BD_TX_RD;
+    b->last_word = word;
+    b->entry = NEXT_INDEX(entry, priv->tx_ring_size);
+    b->count++;
+}
 
-        bl702_emac_write_bd_word(priv, entry, true, 0, attr_len_word);
+// Undo a batch that failed part way, nothing of it was handed to the MAC yet
+static void bl702_emac_tx_unwind(struct bl702_emac_priv *priv, struct bl702_emac_tx_batch *b)
+{
+    unsigned int i, entry = priv->tx_head;
+
+    for (i = 0; i < b->count; i++) {
+        bl702_emac_tx_unmap(priv, entry);
+        // Clear RD, a shorter frame queued next must not run into a stale BD
+        bl702_emac_write_bd_word(priv, entry, true, 0,
+                                 entry == priv->tx_ring_size - 1 ? EMAC_BD_TX_WR : 0);
+        entry = NEXT_INDEX(entry, priv->tx_ring_size);
+    }
+}
 
-        len -= size;
-        offset += size;
-        entry = (entry + 1) % ring_size;
-        desc_count++;
+// Hand a filled batch to the MAC, the first BD last. BD memory is MMIO, the writes
+// stay in order. irq asks for a completion interrupt on the last BD.
+static void bl702_emac_tx_commit(struct bl702_emac_priv *priv, struct bl702_emac_tx_batch *b,
+                                 bool irq)
+{
+    if (irq) {
+        b->last_word |= EMAC_BD_TX_IRQ;
+        if (b->count == 1)
+            b->first_word = b->last_word;
+        else
+            bl702_emac_write_bd_word(priv, (priv->tx_head + b->count - 1) % priv->tx_ring_size,
+                                     true, 0, b->last_word);
     }
+    bl702_emac_write_bd_word(priv, priv->tx_head, true, 0, b->first_word);
+}
 
-    // 5. Map fragments
-    for (i = 0; i < skb_shinfo(skb)->nr_frags; i++) {
+static int bl702_emac_tx_map_skb(struct bl702_emac_priv *priv, struct sk_buff *skb,
+                                 struct bl702_emac_tx_batch *b, unsigned int needed_desc)
+{
+    unsigned int i, len, offset, size;
+    const skb_frag_t *frag;
+    dma_addr_t dma_addr;
+
+    // skb->data
+    len = skb_headlen(skb);
+    offset = 0;
+    while (len) {
+        size = min(len, EMAC_TX_BD_BUF_SIZE);
+        dma_addr = dma_map_single(priv->dev, skb->data + offset, size, DMA_TO_DEVICE);
+        if (dma_mapping_error(priv->dev, dma_addr))
+            return -ENOMEM;
+
+        bl702_emac_tx_add_bd(priv, b, dma_addr, size, size, false, b->count == needed_desc - 1);
+        len -= size;
+        offset += size;
+    }
+
+    // Fragments, the BDs point straight at the skb's pages
+    for (i = 0; i < skb_shinfo(skb)->nr_frags; i++) {
         frag = &skb_shinfo(skb)->frags[i];
-        frag_size = skb_frag_size(frag);
+        len = skb_frag_size(frag);
         offset = 0;
 
-        while (frag_size) {
-            unsigned int size = min(frag_size, EMAC_TX_BD_BUF_SIZE);
+        while (len) {
+            size = min(len, EMAC_TX_BD_BUF_SIZE);
             dma_addr = skb_frag_dma_map(priv->dev, frag, offset, size, DMA_TO_DEVICE);
-            if (dma_mapping_error(priv->dev, dma_addr)) {
-                dev_kfree_skb_any(skb);
-                return NETDEV_TX_OK;
-            }
+            if (dma_mapping_error(priv->dev, dma_addr))
+                return -ENOMEM;
+
+            bl702_emac_tx_add_bd(priv, b, dma_addr, size, size, true, b->count == needed_desc - 1);
+            len -= size;
+            offset += size;
+        }
+    }
 
-            priv->tx_skb_dma_addr[entry] = dma_addr;
-            priv->tx_skb[entry] = NULL;
-            bl702_emac_write_bd_word(priv, entry, true, 4, dma_addr);
+    return 0;
+}
+
+// The MAC has no checksum engine, fill in the IP and TCP checksums of a segment
+// header built from the template. csum covers the segment's payload.
+static void bl702_emac_tso_csum(struct sk_buff *skb, char *hdr, unsigned int data_len, __wsum csum)
+{
+    struct tcphdr *th = (struct tcphdr *)(hdr + skb_transport_offset(skb));
+    unsigned int tcp_len = tcp_hdrlen(skb) + data_len;
 
-            attr_len_word = FIELD_PREP(EMAC_BD_TX_LEN_MASK, size);
-            if (entry == ring_size - 1)
-                attr_len_word |= EMAC_BD_TX_WR;
-            if (desc_count == needed_desc - 1)
-                attr_len_word |= EMAC_BD_TX_EOF_MASK;
-            attr_len_word |= EMAC_BD_TX_CRC | EMAC_BD_TX_PAD | EMAC_BD_TX_RD;
+    th->check = 0;
+    csum = csum_partial(th, tcp_hdrlen(skb), csum);
 
-            bl702_emac_write_bd_word(priv, entry, true, 0, attr_len_word);
+    if (skb_shinfo(skb)->gso_type & SKB_GSO_TCPV4) {
+        struct iphdr *iph = (struct iphdr *)(hdr + skb_network_offset(skb));
 
-            frag_size -= size;
-            offset += size;
-            entry = (entry + 1) % ring_size;
-            desc_count++;
+        iph->check = 0;
+        iph->check = ip_fast_csum(iph, iph->ihl);
+        th->check = csum_tcpudp_magic(iph->saddr, iph->daddr, tcp_len, IPPROTO_TCP, csum);
+    } else {
+        struct ipv6hdr *ip6h = (struct ipv6hdr *)(hdr + skb_network_offset(skb));
+
+        th->check = csum_ipv6_magic(&ip6h->saddr, &ip6h->daddr, tcp_len, IPPROTO_TCP, csum);
+    }
+}
+
+// TSO emulation: one header BD per segment, built from the skb's headers into the
+// header pool slot of that BD, followed by BDs pointing into the skb's own data
+static int bl702_emac_tx_map_tso(struct bl702_emac_priv *priv, struct sk_buff *skb,
+                                 struct bl702_emac_tx_batch *b)
+{
+    int hdr_len, total_len, data_left, seg_off, size;
+    struct tso_t tso;
+    dma_addr_t dma_addr;
+    __wsum csum;
+    char *hdr;
+
+    hdr_len = tso_start(skb, &tso);
+    total_len = skb->len - hdr_len;
+
+    while (total_len > 0) {
+        unsigned int hdr_entry = b->entry;
+
+        data_left = min_t(int, skb_shinfo(skb)->gso_size, total_len);
+        total_len -= data_left;
+
+        hdr = priv->tso_hdrs + hdr_entry * TSO_HEADER_SIZE;
+        tso_build_hdr(skb, hdr, &tso, data_left, total_len == 0);
+        bl702_emac_tx_add_bd(priv, b, priv->tso_hdrs_dma + hdr_entry * TSO_HEADER_SIZE,
+                             hdr_len, 0, false, false);
+
+        csum = 0;
+        seg_off = 0;
+        while (data_left > 0) {
+            size = min3(tso.size, data_left, (int)EMAC_TX_BD_BUF_SIZE);
+            dma_addr = dma_map_single(priv->dev, tso.data, size, DMA_TO_DEVICE);
+            if (dma_mapping_error(priv->dev, dma_addr))
+                return -ENOMEM;
+
+            csum = csum_block_add(csum, csum_partial(tso.data, size, 0), seg_off);
+            bl702_emac_tx_add_bd(priv, b, dma_addr, size, size, false, data_left == size);
+            data_left -= size;
+            seg_off += size;
+            tso_build_data(skb, &tso, size);
         }
+
+        // The header BD is not handed over yet, the pool is coherent
+        bl702_emac_tso_csum(skb, hdr, seg_off, csum);
     }
 
-    // 6. Update statistics and tx_head
-    netdev->stats.tx_packets++;
-    netdev->stats.tx_bytes += skb->len;
-    priv->tx_head = entry;
+    return 0;
+}
 
-    // 7. Stop queue if no room for at least 1 full frame (assume 2 descs min)
-    unsigned int next = (priv->tx_head + 2) % ring_size;
-    u32 next_status = bl702_emac_read_bd_word(priv, next, true, 0);
-    if (next_status & EMAC_BD_TX_RD)
+// Completion interrupt policy of all TX paths. Only the last frame of a burst
+// asks for a completion interrupt, and only once tx-frames frames went out
+// since the last one. The stack sets
+// xmit_more while more frames follow, BQL ends the burst once enough bytes
+// are in flight, and a ring about to stop the queue always gets one so the
+// wake-up cannot be lost. Frames sent without one are reclaimed by the
+// tx-usecs timer. frames is the number of frames just queued, *timer tells
+// whether this call armed that timer.
+static bool bl702_emac_tx_want_irq(struct bl702_emac_priv *priv, unsigned int frames,
+                                   bool stop, bool more, bool *timer)
+{
+    bool irq;
+
+    priv->tx_frames_since_irq += frames;
+    irq = stop || (!more && (priv->tx_frames_since_irq >= priv->tx_coal_frames ||
+                             !priv->tx_coal_usecs));
+    if (irq)
+        priv->tx_frames_since_irq = 0;
+
+    *timer = !irq && priv->tx_coal_usecs && !hrtimer_active(&priv->tx_coal_timer);
+    if (*timer)
+        hrtimer_start(&priv->tx_coal_timer, us_to_ktime(priv->tx_coal_usecs), HRTIMER_MODE_REL);
+    return irq;
+}
+
+static netdev_tx_t bl702_emac_start_xmit(struct sk_buff *skb, struct net_device *netdev)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+    struct bl702_emac_xmit_stats *xstats = &priv->xmit_stats[0];
+    struct bl702_emac_tx_batch b = { .entry = priv->tx_head };
+    unsigned int ring_size = priv->tx_ring_size;
+    unsigned int needed_desc, segs = 1, bytes = skb->len;
+    bool tso = skb_is_gso(skb);
+    bool stop, more, irq, timer;
+    int ret;
+
+    // 1. Count the BDs the skb needs. A frame in too many pieces is copied into
+    //    one buffer, TSO skbs are capped by bl702_emac_features_check(). Frames
+    //    asking for a checksum get it in software, the MAC has no engine.
+    needed_desc = bl702_emac_tx_desc_count(skb);
+    if (!tso) {
+        if (unlikely(needed_desc > BL702_TX_MAX_DESC)) {
+            if (skb_linearize(skb))
+                goto drop;
+            needed_desc = bl702_emac_tx_desc_count(skb);
+        }
+        if (skb->ip_summed == CHECKSUM_PARTIAL && skb_checksum_help(skb))
+            goto drop;
+    }
+
+    // 2. The queue stops while fewer than tx_stop_thresh BDs are free, so this
+    //    only trips if that accounting is broken. Checked before mapping
+    //    anything, there is nothing to undo.
+    if (unlikely(tx_ring_space(b.entry, smp_load_acquire(&priv->tx_tail), ring_size) < needed_desc)) {
         netif_stop_queue(netdev);
+        netdev_err_once(netdev, "TX ring full while the queue was awake\n");
+        return NETDEV_TX_BUSY;
+    }
 
+    // 3. Map the skb, or build its segments
+    if (tso) {
+        ret = bl702_emac_tx_map_tso(priv, skb, &b);
+        segs = skb_shinfo(skb)->gso_segs;
+        bytes += (segs - 1) * skb_tcp_all_headers(skb);
+    } else {
+        ret = bl702_emac_tx_map_skb(priv, skb, &b, needed_desc);
+    }
+    if (ret)
+        goto unwind;
+
+    // 4. Completion interrupt, see bl702_emac_tx_want_irq()
+    stop = tx_ring_space(b.entry, priv->tx_tail, ring_size) < priv->tx_stop_thresh;
+    more = !__netdev_sent_queue(netdev, skb->len, netdev_xmit_more());
+    irq = bl702_emac_tx_want_irq(priv, segs, stop, more, &timer);
+
+    // 5. Hand the batch over. The skb is held by the last EOF BD, which completes last.
+    priv->tx_ring[(priv->tx_head + b.count - 1) % ring_size].skb = skb;
+    bl702_emac_tx_commit(priv, &b, irq);
+
+    // 6. Update statistics and tx_head
+    u64_stats_update_begin(&xstats->syncp);
+    xstats->c.tx_packets += segs;
+    xstats->c.tx_bytes += bytes;
+    xstats->c.tx_tso_skbs += tso;
+    xstats->c.tx_irq_requests += irq;
+    xstats->c.tx_coal_timer_starts += timer;
+    u64_stats_update_end(&xstats->syncp);
+    smp_store_release(&priv->tx_head, b.entry);
+
+    // 7. Stop queue if the next skb might not fit, recheck in case cleanup just ran
+    if (stop) {
+        netif_stop_queue(netdev);
+        smp_mb();
+        if (tx_ring_space(priv->tx_head, READ_ONCE(priv->tx_tail), ring_size) >= priv->tx_stop_thresh)
+            netif_wake_queue(netdev);
+    }
+
+    return NETDEV_TX_OK;
+
+unwind:
+    bl702_emac_tx_unwind(priv, &b);
+drop:
+    dev_kfree_skb_any(skb);
+    u64_stats_update_begin(&xstats->syncp);
+    xstats->c.tx_dropped++;
+    u64_stats_update_end(&xstats->syncp);
     return NETDEV_TX_OK;
 }
 
+// TSO skbs that could need more BDs than an awake queue guarantees go back to
+// the stack's software GSO
+static netdev_features_t bl702_emac_features_check(struct sk_buff *skb, struct net_device *netdev,
+                                                   netdev_features_t features)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+
+    if (skb_is_gso(skb) && bl702_emac_tso_desc_count(skb) > READ_ONCE(priv->tx_stop_thresh))
+        features &= ~NETIF_F_GSO_MASK;
+    return features;
+}
+
+// --- XDP ---
+
+// Queue one XDP frame on a single BD, with the TX queue lock held. XDP_TX frames
+// are pages of our own pool and already mapped, redirected ones are mapped here.
+static int bl702_emac_xdp_queue_frame(struct bl702_emac_priv *priv, struct xdp_frame *xdpf,
+                                      bool dma_map, bool more)
+{
+    struct bl702_emac_xmit_stats *xstats = &priv->xmit_stats[0];
+    struct bl702_emac_tx_batch b = { .entry = priv->tx_head };
+    dma_addr_t dma_addr;
+    bool irq, timer;
+
+    // Never eat into the stop threshold, an awake queue must still fit the next skb
+    if (tx_ring_space(b.entry, smp_load_acquire(&priv->tx_tail), priv->tx_ring_size) <=
+        priv->tx_stop_thresh || xdpf->len > EMAC_TX_BD_BUF_SIZE) {
+        u64_stats_update_begin(&xstats->syncp);
+        xstats->c.tx_xdp_full++;
+        u64_stats_update_end(&xstats->syncp);
+        return -ENOSPC;
+    }
+
+    if (dma_map) {
+        dma_addr = dma_map_single(priv->dev, xdpf->data, xdpf->len, DMA_TO_DEVICE);
+        if (dma_mapping_error(priv->dev, dma_addr))
+            return -ENOMEM;
+    } else {
+        dma_addr = page_pool_get_dma_addr(virt_to_page(xdpf->data)) + sizeof(*xdpf) + xdpf->headroom;
+        dma_sync_single_for_device(priv->dev, dma_addr, xdpf->len, DMA_BIDIRECTIONAL);
+    }
+
+    bl702_emac_tx_add_bd(priv, &b, dma_addr, xdpf->len, dma_map ? xdpf->len : 0, false, true);
+    priv->tx_ring[priv->tx_head].xdpf = xdpf;
+
+    irq = bl702_emac_tx_want_irq(priv, 1, false, more, &timer);
+    bl702_emac_tx_commit(priv, &b, irq);
+
+    u64_stats_update_begin(&xstats->syncp);
+    xstats->c.tx_packets++;
+    xstats->c.tx_bytes += xdpf->len;
+    xstats->c.tx_xdp_frames++;
+    xstats->c.tx_irq_requests += irq;
+    xstats->c.tx_coal_timer_starts += timer;
+    u64_stats_update_end(&xstats->syncp);
+    smp_store_release(&priv->tx_head, b.entry);
+    return 0;
+}
+
+// XDP_TX from NAPI, on this device's TX queue
+static int bl702_emac_xdp_tx_frame(struct bl702_emac_priv *priv, struct xdp_frame *xdpf,
+                                   bool dma_map)
+{
+    struct netdev_queue *nq = netdev_get_tx_queue(priv->netdev, 0);
+    int ret;
+
+    __netif_tx_lock(nq, smp_processor_id());
+    txq_trans_cond_update(nq);
+    ret = bl702_emac_xdp_queue_frame(priv, xdpf, dma_map, false);
+    __netif_tx_unlock(nq);
+    return ret;
+}
+
+// XDP_TX of a page pool frame, it goes out in the page it arrived in
+static int bl702_emac_xdp_tx(struct bl702_emac_priv *priv, struct xdp_buff *xdp)
+{
+    struct xdp_frame *xdpf = xdp_convert_buff_to_frame(xdp);
+
+    if (unlikely(!xdpf))
+        return -EOVERFLOW;
+    return bl702_emac_xdp_tx_frame(priv, xdpf, false);
+}
+
+// ndo_xdp_xmit: frames redirected here by XDP programs, on this or another device
+static int bl702_emac_xdp_xmit(struct net_device *netdev, int n, struct xdp_frame **frames,
+                               u32 flags)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+    struct netdev_queue *nq = netdev_get_tx_queue(netdev, 0);
+    int i, nxmit = 0;
+
+    if (unlikely(flags & ~XDP_XMIT_FLAGS_MASK))
+        return -EINVAL;
+    if (unlikely(!netif_running(netdev) || !netif_carrier_ok(netdev) || priv->rings_down))
+        return -ENETDOWN;
+
+    __netif_tx_lock(nq, smp_processor_id());
+    txq_trans_cond_update(nq);
+    for (i = 0; i < n; i++) {
+        if (bl702_emac_xdp_queue_frame(priv, frames[i], true, i < n - 1))
+            break;
+        nxmit++;
+    }
+    __netif_tx_unlock(nq);
+
+    // The caller frees what was not sent
+    return nxmit;
+}
+
+// AF_XDP zero-copy TX from NAPI, descriptors of the socket's TX ring go out straight
+// from the UMEM, split over BDs like skb data. Queues at most budget frames and, like
+// the XDP paths, leaves the stop threshold free for the stack. Returns the frames queued.
+static unsigned int bl702_emac_xsk_xmit(struct bl702_emac_priv *priv, unsigned int budget)
+{
+    struct netdev_queue *nq = netdev_get_tx_queue(priv->netdev, 0);
+    struct bl702_emac_xmit_stats *xstats = &priv->xmit_stats[0];
+    struct xsk_buff_pool *pool = priv->xsk_pool;
+    // Worst case per descriptor, the core refuses descriptors longer than a chunk
+    unsigned int max_desc = DIV_ROUND_UP(xsk_pool_get_chunk_size(pool), EMAC_TX_BD_BUF_SIZE);
+    unsigned int ring_size = priv->tx_ring_size;
+    unsigned int sent = 0, bytes = 0, irqs = 0, timers = 0, offset, size;
+    bool full = false, irq, timer;
+    struct xdp_desc desc;
+    dma_addr_t dma_addr;
+
+    __netif_tx_lock(nq, smp_processor_id());
+    txq_trans_cond_update(nq);
+    while (sent < budget) {
+        struct bl702_emac_tx_batch b = { .entry = priv->tx_head };
+
+        if (tx_ring_space(b.entry, smp_load_acquire(&priv->tx_tail), ring_size) <
+            priv->tx_stop_thresh + max_desc) {
+            full = true;
+            break;
+        }
+        if (!xsk_tx_peek_desc(pool, &desc))
+            break;
+
+        dma_addr = xsk_buff_raw_get_dma(pool, desc.addr);
+        xsk_buff_raw_dma_sync_for_device(pool, dma_addr, desc.len);
+        for (offset = 0; offset < desc.len; offset += size) {
+            size = min(desc.len - offset, EMAC_TX_BD_BUF_SIZE);
+            bl702_emac_tx_add_bd(priv, &b, dma_addr + offset, size, 0, false,
+                                 offset + size == desc.len);
+        }
+        // The descriptor completes with its last BD
+        priv->tx_ring[(priv->tx_head + b.count - 1) % ring_size].xsk = true;
+
+        // No xmit_more here, coalescing falls back on the frame count and the timer
+        irq = bl702_emac_tx_want_irq(priv, 1, false, false, &timer);
+        bl702_emac_tx_commit(priv, &b, irq);
+        smp_store_release(&priv->tx_head, b.entry);
+
+        sent++;
+        bytes += desc.len;
+        irqs += irq;
+        timers += timer;
+    }
+    if (sent)
+        xsk_tx_release(pool);
+    __netif_tx_unlock(nq);
+
+    // Only a wakeup or a completion runs NAPI again to look at the TX ring
+    if (xsk_uses_need_wakeup(pool))
+        xsk_set_tx_need_wakeup(pool);
+
+    u64_stats_update_begin(&xstats->syncp);
+    xstats->c.tx_packets += sent;
+    xstats->c.tx_bytes += bytes;
+    xstats->c.tx_xsk_frames += sent;
+    xstats->c.tx_xdp_full += full;
+    xstats->c.tx_irq_requests += irqs;
+    xstats->c.tx_coal_timer_starts += timers;
+    u64_stats_update_end(&xstats->syncp);
+    return sent;
+}
+
+// Give an RX BD its own page back after the CPU may have written to it. Dirty
+// lines must not be written back on top of the next frame.
+static void bl702_emac_rx_rearm_synced(struct bl702_emac_priv *priv, unsigned int entry,
+                                       unsigned int sync_len)
+{
+    dma_sync_single_for_device(priv->dev,
+                               page_pool_get_dma_addr(priv->rx_ring[entry].page) + BL702_RX_HEADROOM,
+                               min(sync_len, priv->rx_buf_len),
+                               page_pool_get_dma_dir(priv->page_pool));
+    bl702_emac_arm_rx_bd(priv, entry);
+}
+
+// Count a frame the XDP program has seen, passed frames are counted once delivered
+static void bl702_emac_count_xdp(struct bl702_emac_priv *priv, u32 act, unsigned int len)
+{
+    struct bl702_emac_napi_stats *st = &priv->napi_stats[0];
+
+    u64_stats_update_begin(&st->syncp);
+    if (act == XDP_PASS) {
+        st->c.rx_xdp_pass++;
+    } else {
+        st->c.rx_packets++;
+        st->c.rx_bytes += len;
+        if (act == XDP_DROP)
+            st->c.rx_xdp_drop++;
+        else if (act == XDP_TX)
+            st->c.rx_xdp_tx++;
+        else
+            st->c.rx_xdp_redirect++;
+    }
+    u64_stats_update_end(&st->syncp);
+}
+
+// Run the XDP program on a received frame. XDP_PASS returns with the page taken
+// off the ring, for the caller to build an skb around. Every other verdict is
+// handled here: dropped frames leave their page on the BD, sent and redirected
+// ones take it along and a fresh page takes its place.
+static u32 bl702_emac_rx_xdp(struct bl702_emac_priv *priv, struct bpf_prog *prog,
+                             unsigned int entry, struct xdp_buff *xdp)
+{
+    struct bl702_emac_napi_stats *st = &priv->napi_stats[0];
+    struct page *page = priv->rx_ring[entry].page;
+    unsigned int len = xdp->data_end - xdp->data;
+    unsigned int sync_len;
+    u32 act;
+
+    act = bpf_prog_run_xdp(prog, xdp);
+    // What the program may have written, the head can move and the tail grow
+    sync_len = max_t(int, len, xdp->data_end - xdp->data_hard_start - BL702_RX_HEADROOM);
+
+    switch (act) {
+    case XDP_PASS:
+    case XDP_TX:
+    case XDP_REDIRECT:
+        if (bl702_emac_alloc_rx_page(priv, entry) < 0) {
+            u64_stats_update_begin(&st->syncp);
+            st->c.rx_dropped++;
+            st->c.rx_alloc_failures++;
+            u64_stats_update_end(&st->syncp);
+            bl702_emac_rx_rearm_synced(priv, entry, sync_len);
+            return XDP_DROP;
+        }
+        break;
+    default:
+        bpf_warn_invalid_xdp_action(priv->netdev, prog, act);
+        fallthrough;
+    case XDP_ABORTED:
+        trace_xdp_exception(priv->netdev, prog, act);
+        fallthrough;
+    case XDP_DROP:
+        bl702_emac_rx_rearm_synced(priv, entry, sync_len);
+        act = XDP_DROP;
+        goto count;
+    }
+
+    if ((act == XDP_TX && bl702_emac_xdp_tx(priv, xdp)) ||
+        (act == XDP_REDIRECT && xdp_do_redirect(priv->netdev, xdp, prog))) {
+        // The BD already has a new page, this one goes back to the pool
+        page_pool_put_page(priv->page_pool, page, sync_len, true);
+        act = XDP_DROP;
+    } else if (act == XDP_REDIRECT) {
+        priv->rx_xdp_redirected = true;
+    }
+
+count:
+    bl702_emac_count_xdp(priv, act, len);
+    return act;
+}
+
+static int bl702_emac_xdp_setup(struct net_device *netdev, struct bpf_prog *prog,
+                                struct netlink_ext_ack *extack)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+    bool rebuild = !!priv->xdp_prog != !!prog;
+    struct bpf_prog *old;
+    int ret;
+
+    // XDP buffers are a single page
+    if (prog && bl702_emac_rx_page_order(netdev->mtu)) {
+        NL_SET_ERR_MSG_MOD(extack, "MTU too large for XDP");
+        return -EOPNOTSUPP;
+    }
+
+    old = xchg(&priv->xdp_prog, prog);
+
+    // Attaching the first or detaching the last program changes the RX pages'
+    // DMA direction, the rings are rebuilt around a new page pool
+    if (rebuild && netif_running(netdev)) {
+        ret = bl702_emac_reconfigure_rings(netdev, priv->tx_ring_size, priv->rx_ring_size,
+                                           netdev->mtu);
+        if (ret) {
+            xchg(&priv->xdp_prog, old);
+            bl702_emac_reconfigure_rings(netdev, priv->tx_ring_size, priv->rx_ring_size,
+                                         netdev->mtu);
+            NL_SET_ERR_MSG_MOD(extack, "Failed to rebuild the RX ring for XDP");
+            return ret;
+        }
+    }
+
+    if (old)
+        bpf_prog_put(old);
+    return 0;
+}
+
+// Bind (pool) or release (NULL) the AF_XDP buffer pool of queue 0. The RX BDs then
+// take UMEM frames instead of page pool pages, a running interface rebuilds its rings.
+static int bl702_emac_xsk_pool_setup(struct net_device *netdev, struct xsk_buff_pool *pool,
+                                     u16 queue_id)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+    struct xsk_buff_pool *old = priv->xsk_bound;
+    int ret;
+
+    if (queue_id >= BL702_NUM_QUEUES)
+        return -EINVAL;
+    if (pool == old)
+        return 0;
+    if (pool && old)
+        return -EBUSY;
+
+    if (pool) {
+        // The MAC does not chain RX BDs, a whole frame must fit one UMEM frame
+        if (xsk_pool_get_rx_frame_size(pool) < bl702_emac_rx_buf_len(netdev->mtu))
+            return -EINVAL;
+        ret = xsk_pool_dma_map(pool, priv->dev, 0);
+        if (ret)
+            return ret;
+    }
+
+    priv->xsk_bound = pool;
+    if (netif_running(netdev)) {
+        ret = bl702_emac_reconfigure_rings(netdev, priv->tx_ring_size, priv->rx_ring_size,
+                                           netdev->mtu);
+        if (ret) {
+            priv->xsk_bound = old;
+            bl702_emac_reconfigure_rings(netdev, priv->tx_ring_size, priv->rx_ring_size,
+                                         netdev->mtu);
+            if (pool)
+                xsk_pool_dma_unmap(pool, 0);
+            return ret;
+        }
+    }
+
+    if (old)
+        xsk_pool_dma_unmap(old, 0);
+    return 0;
+}
+
+// ndo_xsk_wakeup: user space added fill ring or TX ring entries, NAPI does both
+static int bl702_emac_xsk_wakeup(struct net_device *netdev, u32 queue_id, u32 flags)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+
+    if (unlikely(!netif_running(netdev) || !netif_carrier_ok(netdev)))
+        return -ENETDOWN;
+    if (queue_id >= BL702_NUM_QUEUES || !READ_ONCE(priv->xsk_pool))
+        return -EINVAL;
+
+    // A poll already running goes round once more instead
+    if (!napi_if_scheduled_mark_missed(&priv->napi))
+        napi_schedule(&priv->napi);
+    return 0;
+}
+
+static int bl702_emac_bpf(struct net_device *netdev, struct netdev_bpf *bpf)
+{
+    switch (bpf->command) {
+    case XDP_SETUP_PROG:
+        return bl702_emac_xdp_setup(netdev, bpf->prog, bpf->extack);
+    case XDP_SETUP_XSK_POOL:
+        return bl702_emac_xsk_pool_setup(netdev, bpf->xsk.pool, bpf->xsk.queue_id);
+    default:
+        return -EINVAL;
+    }
+}
+
 /*
 // --- NAPI Poll Function (for RX) ---
 static int bl702_emac_poll(struct napi_struct *napi, int budget)
@@ -783,147 +1864,451 @@ static int bl702_emac_poll(struct napi_struct *napi, int budget)
     return received_packets;
 }
 */
-static int bl702_emac_replenish_rx_skb(struct bl702_emac_priv *priv, unsigned int entry)
+static bool bl702_emac_handle_rx_errors(struct bl702_emac_priv *priv, u32 attr_len_word)
 {
-    struct net_device *netdev = priv->netdev;
-    struct sk_buff *new_skb;
-    u32 attr_len_word;
-    new_skb = netdev_alloc_skb(netdev, netdev->mtu + ETH_HLEN + ETH_FCS_LEN + NET_IP_ALIGN);
-    if (!new_skb) {
-        dev_err(priv->dev, "Failed to allocate new RX skb\n");
-        netdev->stats.rx_dropped++;
-        return -ENOMEM;
-    }
+	struct bl702_emac_napi_stats *st = &priv->napi_stats[0];
+
+	if (likely(!(attr_len_word & (EMAC_BD_RX_CRC_MASK | EMAC_BD_RX_SF_MASK |
+	                              EMAC_BD_RX_TL_MASK | EMAC_BD_RX_DN_MASK |
+	                              EMAC_BD_RX_RE_MASK | EMAC_BD_RX_OR_MASK |
+	                              EMAC_BD_RX_M_MASK))))
+		return false;
+
+	// One bad frame counts once in rx_errors, whatever the number of reasons
+	u64_stats_update_begin(&st->syncp);
+	st->c.rx_errors++;
+	if (attr_len_word & EMAC_BD_RX_CRC_MASK)
+		st->c.rx_crc_errors++;
+	if (attr_len_word & EMAC_BD_RX_SF_MASK)
+		st->c.rx_short_frames++;
+	if (attr_len_word & EMAC_BD_RX_TL_MASK)
+		st->c.rx_too_long++;
+	if (attr_len_word & EMAC_BD_RX_DN_MASK)
+		st->c.rx_dribble_nibble++;
+	if (attr_len_word & EMAC_BD_RX_RE_MASK)
+		st->c.rx_phy_errors++;
+	if (attr_len_word & EMAC_BD_RX_OR_MASK)
+		st->c.rx_overruns++;
+	if (attr_len_word & EMAC_BD_RX_M_MASK)
+		st->c.rx_missed++;
+	u64_stats_update_end(&st->syncp);
+
+	return true;
+}
+// The MAC has no checksum engine. Sum the frame here, right after the sync while it is
+// still in cache, so the stack checks TCP/UDP against CHECKSUM_COMPLETE instead of
+// reading the payload again. csum_partial is the arch version, Zbb-accelerated on RISC-V.
+static void bl702_emac_rx_csum(struct net_device *netdev, struct sk_buff *skb)
+{
+    if (!(netdev->features & NETIF_F_RXCSUM) || skb->len <= ETH_HLEN)
+        return;
 
-    skb_reserve(new_skb, NET_IP_ALIGN);
-    priv->rx_skb[entry] = new_skb;
+    // Everything after the Ethernet header, FCS included: IP trims it with pskb_trim_rcsum
+    skb->csum = csum_partial(skb->data + ETH_HLEN, skb->len - ETH_HLEN, 0);
+    skb->ip_summed = CHECKSUM_COMPLETE;
+}
 
-    priv->rx_skb_dma_addr[entry] = dma_map_single(priv->dev, new_skb->data,
-                                                  priv->rx_skb_dma_len[entry],
-                                                  DMA_FROM_DEVICE);
-    if (dma_mapping_error(priv->dev, priv->rx_skb_dma_addr[entry])) {
-        dev_err(priv->dev, "Failed to map RX skb for DMA\n");
-        dev_kfree_skb_any(new_skb);
-        priv->rx_skb[entry] = NULL;
-        netdev->stats.rx_dropped++;
-        return -EIO;
-    }
+static int bl702_emac_process_rx_entry(struct bl702_emac_priv *priv, struct napi_struct *napi,
+                                       struct bpf_prog *prog)
+{
+    struct net_device *netdev = priv->netdev;
+    struct bl702_emac_napi_stats *st = &priv->napi_stats[0];
+    unsigned int entry = priv->rx_head;
+    u32 attr_len_word = bl702_emac_read_bd_word(priv, entry, false, 0);
+    struct page *page;
+    struct sk_buff *skb;
+    u32 rx_len;
 
-    bl702_emac_write_bd_word(priv, entry, false, 4, priv->rx_skb_dma_addr[entry]);
+    if (attr_len_word & EMAC_BD_RX_E)
+        return 0; // No more packets
 
-    attr_len_word = EMAC_BD_RX_E | EMAC_BD_RX_IRQ;
-    if (entry == (EMAC_RX_BD_BUM_MAX - 1)) {
-        attr_len_word |= EMAC_BD_RX_WR;
-    }
+    dma_rmb(); // Frame data only after the BD says it is ours
 
-    bl702_emac_write_bd_word(priv, entry, false, 0, attr_len_word);
-    return 0;
-}
+    rx_len = FIELD_GET(EMAC_BD_RX_LEN_MASK, attr_len_word);
+    page = priv->rx_ring[entry].page;
 
-static bool bl702_emac_handle_rx_errors(struct bl702_emac_priv *priv, u32 attr_len_word, struct sk_buff *skb)
-{
-	struct net_device *ndev = priv->ndev;
-	struct net_device_stats *stats = &ndev->stats;
+    // Bad frames leave the page in place, the BD is simply handed back
+    if (bl702_emac_handle_rx_errors(priv, attr_len_word)) {
+        bl702_emac_arm_rx_bd(priv, entry);
+        goto next;
+    }
 
-	if (attr_len_word & EMAC_BD_RX_CRC_MASK) {
-		stats->rx_crc_errors++;
-		stats->rx_errors++;
-	}
+    // XDP sees every good frame first, in the page it arrived in
+    if (prog) {
+        struct xdp_buff xdp;
+
+        dma_sync_single_for_cpu(priv->dev, page_pool_get_dma_addr(page) + BL702_RX_HEADROOM,
+                                rx_len, page_pool_get_dma_dir(priv->page_pool));
+        xdp_init_buff(&xdp, priv->rx_truesize, &priv->xdp_rxq);
+        xdp_prepare_buff(&xdp, page_address(page), BL702_RX_HEADROOM, rx_len, true);
+        if (bl702_emac_rx_xdp(priv, prog, entry, &xdp) != XDP_PASS)
+            goto next;
+
+        // The program may have moved the data or put metadata in front of it
+        skb = napi_build_skb(xdp.data_hard_start, priv->rx_truesize);
+        if (unlikely(!skb)) {
+            page_pool_recycle_direct(priv->page_pool, page);
+            goto alloc_failed;
+        }
+        skb_mark_for_recycle(skb);
+        skb_reserve(skb, xdp.data - xdp.data_hard_start);
+        skb_put(skb, xdp.data_end - xdp.data);
+        if (xdp.data > xdp.data_meta)
+            skb_metadata_set(skb, xdp.data - xdp.data_meta);
+        rx_len = skb->len;
+        goto deliver;
+    }
 
-	if (attr_len_word & EMAC_BD_RX_SF_MASK) {
-		stats->rx_length_errors++;
-		stats->rx_errors++;
-	}
+    // Small frame: copy it and give the same page back without touching the pool
+    if (rx_len < READ_ONCE(priv->rx_copybreak)) {
+        skb = bl702_emac_rx_copy(priv, napi, page, rx_len);
+        bl702_emac_arm_rx_bd(priv, entry);
+        if (unlikely(!skb))
+            goto alloc_failed;
+        u64_stats_update_begin(&st->syncp);
+        st->c.rx_copybreak++;
+        u64_stats_update_end(&st->syncp);
+        goto deliver;
+    }
 
-	if (attr_len_word & EMAC_BD_RX_TL_MASK) {
-		stats->rx_length_errors++;
-		stats->rx_errors++;
-	}
+    // Refill before passing the page up, on failure the frame is dropped and the page reused
+    if (bl702_emac_alloc_rx_page(priv, entry) < 0) {
+        bl702_emac_arm_rx_bd(priv, entry);
+        goto alloc_failed;
+    }
 
-	if (attr_len_word & EMAC_BD_RX_DN_MASK) {
-		stats->rx_frame_errors++;
-		stats->rx_errors++;
-	}
+    dma_sync_single_for_cpu(priv->dev, page_pool_get_dma_addr(page) + BL702_RX_HEADROOM,
+                            rx_len, page_pool_get_dma_dir(priv->page_pool));
 
-	if (attr_len_word & EMAC_BD_RX_RE_MASK) {
-		stats->rx_errors++;
-	}
+    skb = napi_build_skb(page_address(page), priv->rx_truesize);
+    if (unlikely(!skb)) {
+        page_pool_recycle_direct(priv->page_pool, page);
+        goto alloc_failed;
+    }
+    skb_mark_for_recycle(skb); // Page goes back to the pool when the stack frees the skb
+    skb_reserve(skb, BL702_RX_HEADROOM);
+    skb_put(skb, rx_len);
 
-	if (attr_len_word & EMAC_BD_RX_OR_MASK) {
-		stats->rx_over_errors++;
-		stats->rx_fifo_errors++; // Optional, if both are semantically meaningful
-		stats->rx_errors++;
-	}
+deliver:
+    bl702_emac_rx_csum(netdev, skb);
+    skb->protocol = eth_type_trans(skb, netdev);
+    napi_gro_receive(napi, skb);
 
-	if (attr_len_word & EMAC_BD_RX_M_MASK) {
-		stats->rx_missed_errors++;
-		stats->rx_errors++;
-	}
+    u64_stats_update_begin(&st->syncp);
+    st->c.rx_packets++;
+    st->c.rx_bytes += rx_len;
+    u64_stats_update_end(&st->syncp);
+    goto next;
 
-	if (attr_len_word & (EMAC_BD_RX_CRC_MASK | EMAC_BD_RX_SF_MASK | EMAC_BD_RX_TL_MASK |
-	                     EMAC_BD_RX_DN_MASK | EMAC_BD_RX_RE_MASK | EMAC_BD_RX_OR_MASK |
-	                     EMAC_BD_RX_M_MASK)) {
-		dev_kfree_skb_any(skb);
-		return true;
-	}
+alloc_failed:
+    u64_stats_update_begin(&st->syncp);
+    st->c.rx_dropped++;
+    st->c.rx_alloc_failures++;
+    u64_stats_update_end(&st->syncp);
 
-	return false;
+next:
+    priv->rx_head = NEXT_INDEX(priv->rx_head, priv->rx_ring_size);
+    return 1;
 }
-static int bl702_emac_process_rx_entry(struct bl702_emac_priv *priv, struct napi_struct *napi)
+
+// AF_XDP zero-copy RX, the frame is in a UMEM frame. XDP_REDIRECT into the socket's
+// XSKMAP hands that frame to user space as it is. Every other outcome ends with the
+// frame back in the pool, XDP_PASS after copying it into an skb. The BD is armed
+// again by bl702_emac_xsk_refill() at the end of the poll.
+static int bl702_emac_process_rx_xsk(struct bl702_emac_priv *priv, struct napi_struct *napi,
+                                     struct bpf_prog *prog)
 {
     struct net_device *netdev = priv->netdev;
+    struct bl702_emac_napi_stats *st = &priv->napi_stats[0];
     unsigned int entry = priv->rx_head;
-    u32 attr_len_word = bl702_emac_read_bd_word(priv, entry, false, 0);
+    struct xdp_buff *xdp = priv->rx_ring[entry].xsk;
+    unsigned int len, meta_len;
+    struct xdp_frame *xdpf;
+    struct sk_buff *skb;
+    u32 attr_len_word;
+    u32 act = XDP_PASS;
 
+    // A BD without a frame was never armed, its status word is stale
+    if (!xdp)
+        return 0;
+    attr_len_word = bl702_emac_read_bd_word(priv, entry, false, 0);
     if (attr_len_word & EMAC_BD_RX_E)
         return 0; // No more packets
 
-    u32 rx_len = FIELD_GET(EMAC_BD_RX_LEN_MASK, attr_len_word);
-    struct sk_buff *skb = priv->rx_skb[entry];
+    dma_rmb(); // Frame data only after the BD says it is ours
 
-    dma_unmap_single(priv->dev, priv->rx_skb_dma_addr[entry],
-                     priv->rx_skb_dma_len[entry], DMA_FROM_DEVICE);
+    priv->rx_ring[entry].xsk = NULL;
+    priv->rx_head = NEXT_INDEX(entry, priv->rx_ring_size);
 
-    if (bl702_emac_handle_rx_errors(priv, attr_len_word, skb)) {
-        priv->rx_skb[entry] = NULL;
-        goto replenish;
+    if (bl702_emac_handle_rx_errors(priv, attr_len_word)) {
+        xsk_buff_free(xdp);
+        return 1;
     }
 
-    skb_put(skb, rx_len);
+    xsk_buff_set_size(xdp, FIELD_GET(EMAC_BD_RX_LEN_MASK, attr_len_word));
+    xsk_buff_dma_sync_for_cpu(xdp);
+    len = xdp->data_end - xdp->data;
+
+    if (prog) {
+        act = bpf_prog_run_xdp(prog, xdp);
+        switch (act) {
+        case XDP_PASS:
+            break;
+        case XDP_REDIRECT:
+            if (xdp_do_redirect(netdev, xdp, prog))
+                goto drop;
+            priv->rx_xdp_redirected = true;
+            goto count;
+        case XDP_TX:
+            // Copied into a page of its own, which also frees the UMEM frame
+            xdpf = xdp_convert_buff_to_frame(xdp);
+            if (unlikely(!xdpf))
+                goto drop;
+            if (bl702_emac_xdp_tx_frame(priv, xdpf, true)) {
+                xdp_return_frame(xdpf);
+                act = XDP_DROP;
+            }
+            goto count;
+        default:
+            bpf_warn_invalid_xdp_action(netdev, prog, act);
+            fallthrough;
+        case XDP_ABORTED:
+            trace_xdp_exception(netdev, prog, act);
+            fallthrough;
+        case XDP_DROP:
+            goto drop;
+        }
+        len = xdp->data_end - xdp->data;
+    }
+
+    // The UMEM frame belongs to user space, the stack gets a copy
+    meta_len = xdp->data - xdp->data_meta;
+    skb = napi_alloc_skb(napi, meta_len + len);
+    if (unlikely(!skb)) {
+        xsk_buff_free(xdp);
+        u64_stats_update_begin(&st->syncp);
+        st->c.rx_dropped++;
+        st->c.rx_alloc_failures++;
+        u64_stats_update_end(&st->syncp);
+        return 1;
+    }
+    skb_put_data(skb, xdp->data_meta, meta_len + len);
+    __skb_pull(skb, meta_len);
+    if (meta_len)
+        skb_metadata_set(skb, meta_len);
+    xsk_buff_free(xdp);
+
+    if (prog)
+        bl702_emac_count_xdp(priv, XDP_PASS, len);
+    bl702_emac_rx_csum(netdev, skb);
     skb->protocol = eth_type_trans(skb, netdev);
     napi_gro_receive(napi, skb);
 
-    netdev->stats.rx_packets++;
-    netdev->stats.rx_bytes += rx_len;
+    u64_stats_update_begin(&st->syncp);
+    st->c.rx_packets++;
+    st->c.rx_bytes += len;
+    u64_stats_update_end(&st->syncp);
+    return 1;
 
-    priv->rx_skb[entry] = NULL;
+drop:
+    xsk_buff_free(xdp);
+    act = XDP_DROP;
+count:
+    bl702_emac_count_xdp(priv, act, len);
+    return 1;
+}
+// One read of TX_BD_NUM tells how far the MAC got on both rings, instead of a BD
+// read per frame. TXBDPTR is the TX BD it sends next, RXBDPTR the RX BD it fills
+// next, counted from the start of BD memory like the RX BDs themselves.
+static void bl702_emac_read_hw_ptrs(struct bl702_emac_priv *priv, unsigned int *tx_ptr,
+                                    unsigned int *rx_ptr)
+{
+    u32 regval = bl702_emac_readl(priv, EMAC_TX_BD_NUM_OFFSET);
+    unsigned int txp = FIELD_GET(EMAC_TXBDPTR_MASK, regval);
+    unsigned int rxp = FIELD_GET(EMAC_RXBDPTR_MASK, regval);
+
+    // Right after TX_BD_NUM is reprogrammed the pointers may still point outside
+    // the new rings. Fall back to the software indices then: nothing is reclaimed,
+    // and RX reads the BD at rx_head to see whether it was filled.
+    *tx_ptr = txp < priv->tx_ring_size ? txp : priv->tx_tail;
+    if (rxp >= priv->tx_ring_size && rxp < priv->tx_ring_size + priv->rx_ring_size)
+        *rx_ptr = rxp - priv->tx_ring_size;
+    else
+        *rx_ptr = priv->rx_head;
+}
 
-replenish:
-    if (bl702_emac_replenish_rx_skb(priv, entry) < 0)
-        return -1;
+// RX BDs filled since rx_head. Equal pointers mean an empty or a completely full
+// ring, only then is a BD read to tell which.
+static unsigned int bl702_emac_rx_ready(struct bl702_emac_priv *priv, unsigned int rx_ptr)
+{
+    unsigned int ready = (rx_ptr + priv->rx_ring_size - priv->rx_head) % priv->rx_ring_size;
 
-    priv->rx_head = NEXT_INDEX(priv->rx_head, EMAC_RX_BD_BUM_MAX); 
-    return 1;
+    if (!ready && !(bl702_emac_read_bd_word(priv, priv->rx_head, false, 0) & EMAC_BD_RX_E))
+        ready = priv->rx_ring_size;
+    return ready;
+}
+
+// Helper: TX cleanup function, runs from NAPI poll and reclaims at most
+// BL702_TX_CLEAN_BUDGET frames, napi_budget is 0 when called from netpoll.
+// BDs up to tx_ptr (TXBDPTR) are done. Their status words are only read after
+// a TX error interrupt, to account the error bits.
+static unsigned int bl702_emac_tx_cleanup(struct net_device *netdev, int napi_budget,
+                                          unsigned int tx_ptr)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+    unsigned int ring_size = priv->tx_ring_size;
+    unsigned int entry = priv->tx_tail;
+    unsigned int head = smp_load_acquire(&priv->tx_head);
+    unsigned int done = 0, pkts_compl = 0, bytes_compl = 0, xsk_frames = 0;
+    unsigned int bds = min((tx_ptr + ring_size - entry) % ring_size,
+                           (head + ring_size - entry) % ring_size);
+    bool check = READ_ONCE(priv->tx_err_pending);
+    struct bl702_emac_tx_entry *e;
+    u32 attr_len_word = 0;
+    bool xdp_mapped;
+
+    if (check)
+        WRITE_ONCE(priv->tx_err_pending, false);
+
+    for (; bds && done < BL702_TX_CLEAN_BUDGET; bds--) {
+        if (check) {
+            attr_len_word = bl702_emac_read_bd_word(priv, entry, true, 0);
+            if (attr_len_word & EMAC_BD_TX_RD)
+                break;
+        }
+
+        e = &priv->tx_ring[entry];
+        // tx_unmap() clears dma_len, an XDP frame with a mapping came from ndo_xdp_xmit
+        xdp_mapped = e->dma_len != 0;
+
+        // Descriptor is done: unmap it before anything on it is freed or returned,
+        // the EOF BD of a frame also frees the skb
+        bl702_emac_tx_unmap(priv, entry);
+
+        // XDP frames: mapped here for ndo_xdp_xmit, our own pool pages for XDP_TX
+        if (e->xdpf) {
+            if (xdp_mapped || !napi_budget)
+                xdp_return_frame(e->xdpf);
+            else
+                xdp_return_frame_rx_napi(e->xdpf);
+            e->xdpf = NULL;
+            done++;
+        }
+
+        // AF_XDP descriptors sent from the UMEM, completed in order in one go below
+        if (e->xsk) {
+            e->xsk = false;
+            xsk_frames++;
+            done++;
+        }
+
+        if (e->skb) {
+            done++;
+            pkts_compl++;
+            bytes_compl += e->skb->len;
+            napi_consume_skb(e->skb, napi_budget);
+            e->skb = NULL;
+        }
+
+        // Update error stats if any errors flagged
+        if (attr_len_word & (EMAC_BD_TX_CS | EMAC_BD_TX_DF | EMAC_BD_TX_LC |
+                             EMAC_BD_TX_RL | EMAC_BD_TX_UR)) {
+            struct bl702_emac_napi_stats *st = &priv->napi_stats[0];
+
+            u64_stats_update_begin(&st->syncp);
+            st->c.tx_errors++;
+            if (attr_len_word & EMAC_BD_TX_CS)
+                st->c.tx_carrier_lost++;
+            if (attr_len_word & EMAC_BD_TX_DF)
+                st->c.tx_deferred++;
+            if (attr_len_word & EMAC_BD_TX_LC)
+                st->c.tx_late_collisions++;
+            if (attr_len_word & EMAC_BD_TX_RL)
+                st->c.tx_retry_limit++;
+            if (attr_len_word & EMAC_BD_TX_UR)
+                st->c.tx_underruns++;
+            u64_stats_update_end(&st->syncp);
+        }
+
+        // Advance tail pointer with wrap-around
+        entry = NEXT_INDEX(entry, priv->tx_ring_size);
+    }
+
+    // Out of budget before the errored BDs were seen, check again next poll
+    if (check && bds)
+        WRITE_ONCE(priv->tx_err_pending, true);
+
+    // Release BQL credit for what completed, this may restart a queue BQL stopped
+    netdev_completed_queue(netdev, pkts_compl, bytes_compl);
+    if (xsk_frames)
+        xsk_tx_completed(priv->xsk_pool, xsk_frames);
+
+    smp_store_release(&priv->tx_tail, entry);
+    smp_mb(); // Pairs with the recheck after netif_stop_queue in start_xmit
+
+    // Wake queue if it was stopped and space is available
+    if (netif_queue_stopped(netdev) &&
+        tx_ring_space(READ_ONCE(priv->tx_head), entry, priv->tx_ring_size) >= priv->tx_stop_thresh) {
+       netif_wake_queue(netdev);
+    }
+
+    return done;
+}
+
+static void bl702_emac_unmask_napi_irqs(struct bl702_emac_priv *priv)
+{
+    u32 mask = bl702_emac_readl(priv, EMAC_INT_MASK_OFFSET);
+
+    mask |= BL702_NAPI_INT_MASK;
+    bl702_emac_writel(priv, mask, EMAC_INT_MASK_OFFSET);
 }
-static bool bl702_rx_pending(struct bl702_emac_priv *priv)
+
+// Feed net_dim the packet and byte totals at the end of each interrupt driven cycle.
+// Only NAPI writes these counters, so they are read without the u64_stats retry.
+static void bl702_emac_rx_dim_update(struct bl702_emac_priv *priv)
 {
-	unsigned int entry;
-	u32 status;
-	entry = priv->rx_head;
-	status = bl702_emac_read_bd_word(priv, entry, false, 0)
-	
-	rmb();  // Make sure DMA writes are visible
+    const struct bl702_emac_napi_counters *c = &priv->napi_stats[0].c;
+    struct dim_sample sample = {};
 
-	return !(status & EMAC_BD_RX_E_MASK);  // Adjust this based on your descriptor
+    dim_update_sample(++priv->rx_dim_events, c->rx_packets, c->rx_bytes, &sample);
+    net_dim(&priv->rx_dim, sample);
+}
+
+// net_dim picked a new profile, the holdoff uses it from the next NAPI cycle on
+static void bl702_emac_rx_dim_work(struct work_struct *work)
+{
+    struct dim *dim = container_of(work, struct dim, work);
+    struct bl702_emac_priv *priv = container_of(dim, struct bl702_emac_priv, rx_dim);
+    const struct dim_cq_moder *moder = &bl702_emac_rx_dim_profile[dim->profile_ix];
+
+    WRITE_ONCE(priv->rx_coal_usecs, moder->usec);
+    WRITE_ONCE(priv->rx_coal_frames, moder->pkts);
+    dim->state = DIM_START_MEASURE;
 }
 
 static int bl702_emac_poll(struct napi_struct *napi, int budget)
 {
     struct bl702_emac_priv *priv = container_of(napi, struct bl702_emac_priv, napi);
+    struct bpf_prog *prog = READ_ONCE(priv->xdp_prog);
+    struct xsk_buff_pool *xsk = priv->xsk_pool;
+    unsigned int tx_ptr, rx_ptr, rx_ready;
     int received_packets = 0;
+    bool tx_pending, rx_starved = false;
 
-    while (received_packets < budget) {
-        int ret = bl702_emac_process_rx_entry(priv, napi);
+    bl702_emac_read_hw_ptrs(priv, &tx_ptr, &rx_ptr);
+
+    // Reclaim TX first so a stopped queue can restart while RX is processed
+    tx_pending = bl702_emac_tx_cleanup(priv->netdev, budget, tx_ptr) == BL702_TX_CLEAN_BUDGET;
+
+    // AF_XDP TX, into the BDs just reclaimed
+    if (xsk && budget)
+        tx_pending |= bl702_emac_xsk_xmit(priv, BL702_TX_CLEAN_BUDGET) == BL702_TX_CLEAN_BUDGET;
+
+    // Each filled BD is still read once, for its length and status
+    rx_ready = bl702_emac_rx_ready(priv, rx_ptr);
+    while (received_packets < budget && rx_ready--) {
+        int ret = xsk ? bl702_emac_process_rx_xsk(priv, napi, prog) :
+                        bl702_emac_process_rx_entry(priv, napi, prog);
         if (ret == 0)  // No more packets
             break;
         if (ret < 0)   // Replenishment failed or error
@@ -932,63 +2317,62 @@ static int bl702_emac_poll(struct napi_struct *napi, int budget)
         received_packets++;
     }
 
-    if (received_packets < budget) {
-        napi_complete_done(napi, received_packets);
-        u32 mask = bl702_emac_readl(priv, EMAC_INT_MASK_OFFSET);
-        mask |= (EMAC_RXB_M | EMAC_RXC_M);
-        bl702_emac_writel(priv, mask, EMAC_INT_MASK_OFFSET);
-	
+    if (priv->rx_xdp_redirected) {
+        priv->rx_xdp_redirected = false;
+        xdp_do_flush();
     }
 
-    return received_packets;
-}
+    // Give the BDs emptied above new UMEM frames. With need_wakeup, user space is
+    // told to kick us once the fill ring has frames again. Without it NAPI keeps
+    // polling, nothing else would arm the BDs.
+    if (xsk && !bl702_emac_xsk_refill(priv)) {
+        u64_stats_update_begin(&priv->napi_stats[0].syncp);
+        priv->napi_stats[0].c.rx_xsk_fill_empty++;
+        u64_stats_update_end(&priv->napi_stats[0].syncp);
+        if (xsk_uses_need_wakeup(xsk))
+            xsk_set_rx_need_wakeup(xsk);
+        else
+            rx_starved = true;
+    } else if (xsk && xsk_uses_need_wakeup(xsk)) {
+        xsk_clear_rx_need_wakeup(xsk);
+    }
 
-static inline unsigned int tx_ring_space(unsigned int tx_head, unsigned int tx_tail, unsigned int ring_size)
-{
-    if (tx_tail > tx_head)
-        return tx_tail - tx_head - 1;
-    else
-        return ring_size + tx_tail - tx_head - 1;
-}
+    // TX work left over keeps NAPI scheduled, sources stay masked
+    if (tx_pending || rx_starved)
+        return budget;
 
-// Helper: TX cleanup function
-static void bl702_emac_tx_cleanup(struct net_device *netdev)
-{
-    struct bl702_emac_priv *priv = netdev_priv(netdev);
-    unsigned int entry = priv->tx_tail;
-    u32 attr_len_word;
+    if (received_packets < budget && napi_complete_done(napi, received_packets)) {
+        if (READ_ONCE(priv->rx_dim_enabled))
+            bl702_emac_rx_dim_update(priv);
 
-    while (entry != priv->tx_head) {
-        attr_len_word = bl702_emac_read_bd_word(priv, entry, true, 0);
-        if (attr_len_word & EMAC_BD_TX_RD) {
-            // Hardware still owns descriptor, stop cleanup
-            break;
-        }
-
-        // Descriptor is done: unmap and free skb
-        dma_unmap_single(priv->dev, priv->tx_skb_dma_addr[entry],
-                         priv->tx_skb_dma_len[entry], DMA_TO_DEVICE);
-        dev_kfree_skb_any(priv->tx_skb[entry]);
-        priv->tx_skb[entry] = NULL;
+        // A busy cycle keeps the sources masked for rx-usecs, the timer unmasks them
+        if (priv->rx_coal_usecs && received_packets >= priv->rx_coal_frames)
+            hrtimer_start(&priv->rx_coal_timer, us_to_ktime(priv->rx_coal_usecs),
+                          HRTIMER_MODE_REL_PINNED);
+        else
+            bl702_emac_unmask_napi_irqs(priv);
+    }
 
-        // Update error stats if any errors flagged
-        if (attr_len_word & (EMAC_BD_TX_CS | EMAC_BD_TX_DF | EMAC_BD_TX_LC |
-                             EMAC_BD_TX_RL | EMAC_BD_TX_UR)) {
-            netdev->stats.tx_errors++;
-        }
+    return received_packets;
+}
 
-        // Advance tail pointer with wrap-around
-        entry = NEXT_INDEX(entry, EMAC_TX_BD_BUM_MAX);
-    }
+static enum hrtimer_restart bl702_emac_tx_coal_timer(struct hrtimer *timer)
+{
+    struct bl702_emac_priv *priv = container_of(timer, struct bl702_emac_priv, tx_coal_timer);
 
-    priv->tx_tail = entry;
+    napi_schedule(&priv->napi);
+    return HRTIMER_NORESTART;
+}
 
-    // Wake queue if it was stopped and space is available
-    if (netif_queue_stopped(netdev) && tx_ring_space(priv->tx_head, priv->tx_tail, EMAC_TX_BD_BUM_MAX) > 0) {
-       netif_wake_queue(netdev);
-    }
+static enum hrtimer_restart bl702_emac_rx_coal_timer(struct hrtimer *timer)
+{
+    struct bl702_emac_priv *priv = container_of(timer, struct bl702_emac_priv, rx_coal_timer);
 
+    // Anything that completed during the holdoff is latched in INT_SOURCE and fires now
+    bl702_emac_unmask_napi_irqs(priv);
+    return HRTIMER_NORESTART;
 }
+
 // --- Interrupt Handler ---
 static irqreturn_t bl702_emac_irq(int irq, void *dev_id)
 {
@@ -1006,39 +2390,41 @@ static irqreturn_t bl702_emac_irq(int irq, void *dev_id)
 
     ret = IRQ_HANDLED;
 
-    // Handle RX frame interrupt - schedule NAPI poll
-    if (int_status & EMAC_RXB) {
+    // Handle RX frame and TX done interrupts - both are serviced by NAPI poll
+    if (int_status & (EMAC_RXB | EMAC_RXC | EMAC_TXB | EMAC_TXC)) {
         if (napi_schedule_prep(&priv->napi)) {
-            __napi_schedule(&priv->napi);
-            // Mask RX interrupts until NAPI done
+            // Mask RX/TX completion interrupts until NAPI done
             u32 mask = bl702_emac_readl(priv, EMAC_INT_MASK_OFFSET);
-            mask &= ~(EMAC_RXB_M | EMAC_RXC_M | EMAC_RXE_M);
+            mask &= ~BL702_NAPI_INT_MASK;
             bl702_emac_writel(priv, mask, EMAC_INT_MASK_OFFSET);
+            __napi_schedule(&priv->napi);
         }
     }
 
     // Handle RX error interrupt
     if (int_status & EMAC_RXE) {
-        netdev->stats.rx_errors++;
+        u64_stats_update_begin(&priv->irq_stats.syncp);
+        priv->irq_stats.c.rx_error_irqs++;
+        u64_stats_update_end(&priv->irq_stats.syncp);
         dev_warn(priv->dev, "EMAC RX error interrupt\n");
         // Optionally add further RX error recovery here
     }
 
-    // Handle TX complete or TX buffer interrupt - clean up TX
-    if (int_status & (EMAC_TXB | EMAC_TXC)) {
-        bl702_emac_tx_cleanup(netdev);
-    }
-
     // Handle TX error interrupt
     if (int_status & EMAC_TXE) {
-        netdev->stats.tx_errors++;
+        WRITE_ONCE(priv->tx_err_pending, true);
+        u64_stats_update_begin(&priv->irq_stats.syncp);
+        priv->irq_stats.c.tx_error_irqs++;
+        u64_stats_update_end(&priv->irq_stats.syncp);
         dev_warn(priv->dev, "EMAC TX error interrupt\n");
         // Optionally add further TX error recovery here
     }
 
     // Handle BUSY interrupt - no empty RX BD available
     if (int_status & EMAC_BUSY) {
-        netdev->stats.rx_fifo_errors++;
+        u64_stats_update_begin(&priv->irq_stats.syncp);
+        priv->irq_stats.c.rx_busy++;
+        u64_stats_update_end(&priv->irq_stats.syncp);
         dev_warn(priv->dev, "EMAC RX Busy interrupt - no empty RX buffers\n");
         // Could trigger some recovery or notification here
     }
@@ -1048,13 +2434,364 @@ static irqreturn_t bl702_emac_irq(int irq, void *dev_id)
     return ret;
 }
 
+// --- Ethtool Operations ---
+
+static int bl702_emac_get_tunable(struct net_device *netdev,
+                                  const struct ethtool_tunable *tuna, void *data)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+
+    switch (tuna->id) {
+    case ETHTOOL_RX_COPYBREAK:
+        *(u32 *)data = priv->rx_copybreak;
+        return 0;
+    default:
+        return -EOPNOTSUPP;
+    }
+}
+
+static int bl702_emac_set_tunable(struct net_device *netdev,
+                                  const struct ethtool_tunable *tuna, const void *data)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+    u32 val;
+
+    switch (tuna->id) {
+    case ETHTOOL_RX_COPYBREAK:
+        val = *(const u32 *)data;
+        // 0 turns copybreak off, anything above a full frame would copy every packet
+        if (val > netdev->mtu + ETH_HLEN + ETH_FCS_LEN)
+            return -EINVAL;
+        WRITE_ONCE(priv->rx_copybreak, val);
+        return 0;
+    default:
+        return -EOPNOTSUPP;
+    }
+}
+
+static void bl702_emac_get_drvinfo(struct net_device *netdev, struct ethtool_drvinfo *info)
+{
+    strscpy(info->driver, DRV_NAME, sizeof(info->driver));
+    strscpy(info->version, DRV_VERSION, sizeof(info->version));
+    strscpy(info->bus_info, dev_name(netdev->dev.parent), sizeof(info->bus_info));
+}
+
+// ethtool -l, one combined channel for the single BD ring pair
+static void bl702_emac_get_channels(struct net_device *netdev, struct ethtool_channels *ch)
+{
+    ch->max_combined = BL702_NUM_QUEUES;
+    ch->combined_count = BL702_NUM_QUEUES;
+}
+
+static void bl702_emac_get_ringparam(struct net_device *netdev, struct ethtool_ringparam *ring,
+                                     struct kernel_ethtool_ringparam *kernel_ring,
+                                     struct netlink_ext_ack *extack)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+
+    ring->tx_max_pending = BL702_BD_TOTAL - BL702_RING_MIN;
+    ring->rx_max_pending = BL702_BD_TOTAL - BL702_RING_MIN;
+    ring->tx_pending = priv->tx_ring_size;
+    ring->rx_pending = priv->rx_ring_size;
+}
+
+static int bl702_emac_set_ringparam(struct net_device *netdev, struct ethtool_ringparam *ring,
+                                    struct kernel_ethtool_ringparam *kernel_ring,
+                                    struct netlink_ext_ack *extack)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+
+    if (ring->rx_mini_pending || ring->rx_jumbo_pending)
+        return -EINVAL;
+    if (ring->tx_pending < BL702_RING_MIN || ring->rx_pending < BL702_RING_MIN) {
+        NL_SET_ERR_MSG_MOD(extack, "each ring needs at least 8 BDs");
+        return -EINVAL;
+    }
+    // Both rings are carved out of the same internal BD memory
+    if (ring->tx_pending + ring->rx_pending > BL702_BD_TOTAL) {
+        NL_SET_ERR_MSG_MOD(extack, "TX and RX rings share 128 BDs");
+        return -EINVAL;
+    }
+    if (ring->tx_pending == priv->tx_ring_size && ring->rx_pending == priv->rx_ring_size)
+        return 0;
+
+    return bl702_emac_reconfigure_rings(netdev, ring->tx_pending, ring->rx_pending, netdev->mtu);
+}
+
+/*
+ * The MAC has no coalescing hardware, only a per-BD interrupt request bit, so:
+ *  tx-frames  request a TX interrupt at most once per this many frames (at a burst end)
+ *  tx-usecs   reclaim frames sent without an interrupt after this long, 0 asks for one every burst
+ *  rx-usecs   after a NAPI cycle that handled at least rx-frames packets, keep completion
+ *             interrupts masked for this long, which caps the interrupt rate; 0 disables it
+ *  rx-frames  lighter cycles re-enable interrupts at once to keep latency low
+ *  adaptive-rx  net_dim picks rx-usecs and rx-frames from bl702_emac_rx_dim_profile
+ *             by the measured packet rate, values set by hand hold until its first pick
+ */
+static int bl702_emac_get_coalesce(struct net_device *netdev, struct ethtool_coalesce *ec,
+                                   struct kernel_ethtool_coalesce *kernel_coal,
+                                   struct netlink_ext_ack *extack)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+
+    ec->tx_max_coalesced_frames = priv->tx_coal_frames;
+    ec->tx_coalesce_usecs = priv->tx_coal_usecs;
+    ec->rx_max_coalesced_frames = priv->rx_coal_frames;
+    ec->rx_coalesce_usecs = priv->rx_coal_usecs;
+    ec->use_adaptive_rx_coalesce = priv->rx_dim_enabled;
+    return 0;
+}
+
+static int bl702_emac_set_coalesce(struct net_device *netdev, struct ethtool_coalesce *ec,
+                                   struct kernel_ethtool_coalesce *kernel_coal,
+                                   struct netlink_ext_ack *extack)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+
+    if (!ec->tx_max_coalesced_frames || ec->tx_max_coalesced_frames > BL702_BD_TOTAL ||
+        !ec->rx_max_coalesced_frames || ec->rx_max_coalesced_frames > BL702_BD_TOTAL)
+        return -EINVAL;
+    if (ec->tx_coalesce_usecs > BL702_COAL_USECS_MAX || ec->rx_coalesce_usecs > BL702_COAL_USECS_MAX)
+        return -EINVAL;
+
+    WRITE_ONCE(priv->tx_coal_frames, ec->tx_max_coalesced_frames);
+    WRITE_ONCE(priv->tx_coal_usecs, ec->tx_coalesce_usecs);
+    WRITE_ONCE(priv->rx_coal_frames, ec->rx_max_coalesced_frames);
+    WRITE_ONCE(priv->rx_coal_usecs, ec->rx_coalesce_usecs);
+    // Read by NAPI only, a stale value costs one cycle
+    WRITE_ONCE(priv->rx_dim_enabled, !!ec->use_adaptive_rx_coalesce);
+    return 0;
+}
+
+// Consistent snapshots of one queue's counter groups, and of the IRQ group
+static void bl702_emac_read_queue_stats(struct bl702_emac_priv *priv, int q,
+                                        struct bl702_emac_napi_counters *napi,
+                                        struct bl702_emac_xmit_counters *xmit)
+{
+    const struct bl702_emac_napi_stats *ns = &priv->napi_stats[q];
+    const struct bl702_emac_xmit_stats *xs = &priv->xmit_stats[q];
+    unsigned int start;
+
+    do {
+        start = u64_stats_fetch_begin(&ns->syncp);
+        *napi = ns->c;
+    } while (u64_stats_fetch_retry(&ns->syncp, start));
+
+    do {
+        start = u64_stats_fetch_begin(&xs->syncp);
+        *xmit = xs->c;
+    } while (u64_stats_fetch_retry(&xs->syncp, start));
+}
+
+static void bl702_emac_read_irq_stats(struct bl702_emac_priv *priv,
+                                      struct bl702_emac_irq_counters *irq)
+{
+    unsigned int start;
+
+    do {
+        start = u64_stats_fetch_begin(&priv->irq_stats.syncp);
+        *irq = priv->irq_stats.c;
+    } while (u64_stats_fetch_retry(&priv->irq_stats.syncp, start));
+}
+
+enum {
+    BL702_STATS_NAPI,
+    BL702_STATS_XMIT,
+    BL702_STATS_IRQ,
+};
+
+struct bl702_emac_stat {
+    char name[ETH_GSTRING_LEN];
+    int group;
+    size_t offset;
+};
+
+#define BL702_STAT(g, type, m) { #m, g, offsetof(struct type, m) }
+#define BL702_NAPI_STAT(m) BL702_STAT(BL702_STATS_NAPI, bl702_emac_napi_counters, m)
+#define BL702_XMIT_STAT(m) BL702_STAT(BL702_STATS_XMIT, bl702_emac_xmit_counters, m)
+#define BL702_IRQ_STAT(m) BL702_STAT(BL702_STATS_IRQ, bl702_emac_irq_counters, m)
+
+// Driver wide counters, NAPI and xmit ones are summed over the queues
+static const struct bl702_emac_stat bl702_emac_gstrings[] = {
+    BL702_NAPI_STAT(rx_crc_errors),
+    BL702_NAPI_STAT(rx_short_frames),
+    BL702_NAPI_STAT(rx_too_long),
+    BL702_NAPI_STAT(rx_dribble_nibble),
+    BL702_NAPI_STAT(rx_phy_errors),
+    BL702_NAPI_STAT(rx_overruns),
+    BL702_NAPI_STAT(rx_missed),
+    BL702_NAPI_STAT(rx_copybreak),
+    BL702_NAPI_STAT(rx_alloc_failures),
+    BL702_NAPI_STAT(rx_xdp_pass),
+    BL702_NAPI_STAT(rx_xdp_drop),
+    BL702_NAPI_STAT(rx_xdp_tx),
+    BL702_NAPI_STAT(rx_xdp_redirect),
+    BL702_NAPI_STAT(rx_xsk_fill_empty),
+    BL702_IRQ_STAT(rx_error_irqs),
+    BL702_IRQ_STAT(rx_busy),
+    BL702_NAPI_STAT(tx_carrier_lost),
+    BL702_NAPI_STAT(tx_deferred),
+    BL702_NAPI_STAT(tx_late_collisions),
+    BL702_NAPI_STAT(tx_retry_limit),
+    BL702_NAPI_STAT(tx_underruns),
+    BL702_IRQ_STAT(tx_error_irqs),
+    BL702_XMIT_STAT(tx_tso_skbs),
+    BL702_XMIT_STAT(tx_xdp_frames),
+    BL702_XMIT_STAT(tx_xdp_full),
+    BL702_XMIT_STAT(tx_xsk_frames),
+    BL702_XMIT_STAT(tx_irq_requests),
+    BL702_XMIT_STAT(tx_coal_timer_starts),
+};
+
+#define BL702_XSTATS_LEN ARRAY_SIZE(bl702_emac_gstrings)
+// Per queue: rx packets, rx bytes, tx packets, tx bytes
+#define BL702_QSTATS_LEN (BL702_NUM_QUEUES * 4)
+// mmio_reads, mmio_writes
+#define BL702_MMIO_STATS_LEN (BL702_MMIO_STATS ? 2 : 0)
+#define BL702_STAT_AT(base, off) (*(const u64 *)((const u8 *)(base) + (off)))
+
+static int bl702_emac_get_sset_count(struct net_device *netdev, int sset)
+{
+    switch (sset) {
+    case ETH_SS_STATS:
+        return BL702_XSTATS_LEN + BL702_QSTATS_LEN + BL702_MMIO_STATS_LEN;
+    default:
+        return -EOPNOTSUPP;
+    }
+}
+
+static void bl702_emac_get_strings(struct net_device *netdev, u32 stringset, u8 *data)
+{
+    int i;
+
+    if (stringset != ETH_SS_STATS)
+        return;
+
+    for (i = 0; i < BL702_XSTATS_LEN; i++)
+        ethtool_sprintf(&data, "%s", bl702_emac_gstrings[i].name);
+    for (i = 0; i < BL702_NUM_QUEUES; i++) {
+        ethtool_sprintf(&data, "rx_queue_%d_packets", i);
+        ethtool_sprintf(&data, "rx_queue_%d_bytes", i);
+        ethtool_sprintf(&data, "tx_queue_%d_packets", i);
+        ethtool_sprintf(&data, "tx_queue_%d_bytes", i);
+    }
+    if (BL702_MMIO_STATS) {
+        ethtool_sprintf(&data, "mmio_reads");
+        ethtool_sprintf(&data, "mmio_writes");
+    }
+}
+
+static void bl702_emac_get_ethtool_stats(struct net_device *netdev,
+                                         struct ethtool_stats *stats, u64 *data)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+    struct bl702_emac_napi_counters napi[BL702_NUM_QUEUES];
+    struct bl702_emac_xmit_counters xmit[BL702_NUM_QUEUES];
+    struct bl702_emac_irq_counters irq;
+    int i, q;
+
+    for (q = 0; q < BL702_NUM_QUEUES; q++)
+        bl702_emac_read_queue_stats(priv, q, &napi[q], &xmit[q]);
+    bl702_emac_read_irq_stats(priv, &irq);
+
+    for (i = 0; i < BL702_XSTATS_LEN; i++) {
+        const struct bl702_emac_stat *st = &bl702_emac_gstrings[i];
+        u64 val = 0;
+
+        if (st->group == BL702_STATS_IRQ) {
+            val = BL702_STAT_AT(&irq, st->offset);
+        } else {
+            for (q = 0; q < BL702_NUM_QUEUES; q++) {
+                if (st->group == BL702_STATS_NAPI)
+                    val += BL702_STAT_AT(&napi[q], st->offset);
+                else
+                    val += BL702_STAT_AT(&xmit[q], st->offset);
+            }
+        }
+        *data++ = val;
+    }
+    for (q = 0; q < BL702_NUM_QUEUES; q++) {
+        *data++ = napi[q].rx_packets;
+        *data++ = napi[q].rx_bytes;
+        *data++ = xmit[q].tx_packets;
+        *data++ = xmit[q].tx_bytes;
+    }
+    if (BL702_MMIO_STATS) {
+        *data++ = atomic_long_read(&priv->mmio_reads);
+        *data++ = atomic_long_read(&priv->mmio_writes);
+    }
+}
+
+static const struct ethtool_ops bl702_emac_ethtool_ops = {
+    .supported_coalesce_params = ETHTOOL_COALESCE_USECS | ETHTOOL_COALESCE_MAX_FRAMES |
+                                 ETHTOOL_COALESCE_USE_ADAPTIVE_RX,
+    .get_drvinfo = bl702_emac_get_drvinfo,
+    .get_link = ethtool_op_get_link,
+    .get_channels = bl702_emac_get_channels,
+    .get_ringparam = bl702_emac_get_ringparam,
+    .set_ringparam = bl702_emac_set_ringparam,
+    .get_coalesce = bl702_emac_get_coalesce,
+    .set_coalesce = bl702_emac_set_coalesce,
+    .get_sset_count = bl702_emac_get_sset_count,
+    .get_strings = bl702_emac_get_strings,
+    .get_ethtool_stats = bl702_emac_get_ethtool_stats,
+    .get_tunable = bl702_emac_get_tunable,
+    .set_tunable = bl702_emac_set_tunable,
+};
+
+
+// Lockless, each counter group is snapshotted under its own u64_stats_sync
+static void bl702_emac_get_stats64(struct net_device *netdev, struct rtnl_link_stats64 *stats)
+{
+    struct bl702_emac_priv *priv = netdev_priv(netdev);
+    struct bl702_emac_napi_counters napi;
+    struct bl702_emac_xmit_counters xmit;
+    struct bl702_emac_irq_counters irq;
+    int q;
+
+    for (q = 0; q < BL702_NUM_QUEUES; q++) {
+        bl702_emac_read_queue_stats(priv, q, &napi, &xmit);
+
+        stats->rx_packets += napi.rx_packets;
+        stats->rx_bytes += napi.rx_bytes;
+        stats->rx_dropped += napi.rx_dropped;
+        stats->rx_errors += napi.rx_errors;
+        stats->rx_crc_errors += napi.rx_crc_errors;
+        stats->rx_length_errors += napi.rx_short_frames + napi.rx_too_long;
+        stats->rx_frame_errors += napi.rx_dribble_nibble;
+        stats->rx_over_errors += napi.rx_overruns;
+        stats->rx_fifo_errors += napi.rx_overruns;
+        stats->rx_missed_errors += napi.rx_missed;
+        stats->tx_errors += napi.tx_errors;
+        stats->tx_carrier_errors += napi.tx_carrier_lost;
+        stats->tx_window_errors += napi.tx_late_collisions;
+        stats->tx_aborted_errors += napi.tx_retry_limit;
+        stats->tx_fifo_errors += napi.tx_underruns;
+
+        stats->tx_packets += xmit.tx_packets;
+        stats->tx_bytes += xmit.tx_bytes;
+        stats->tx_dropped += xmit.tx_dropped;
+    }
+
+    bl702_emac_read_irq_stats(priv, &irq);
+    stats->rx_errors += irq.rx_error_irqs;
+    stats->tx_errors += irq.tx_error_irqs;
+    stats->rx_fifo_errors += irq.rx_busy;
+}
+
 static const struct net_device_ops bl702_emac_netdev_ops = {
     .ndo_open = bl702_emac_open,
     .ndo_stop = bl702_emac_stop,
     .ndo_start_xmit = bl702_emac_start_xmit,
+    .ndo_features_check = bl702_emac_features_check,
+    .ndo_bpf = bl702_emac_bpf,
+    .ndo_xdp_xmit = bl702_emac_xdp_xmit,
+    .ndo_xsk_wakeup = bl702_emac_xsk_wakeup,
     .ndo_set_mac_address = eth_mac_addr, // Use common helper
+    .ndo_set_rx_mode = bl702_emac_set_rx_mode,
+    .ndo_change_mtu = bl702_emac_change_mtu,
     .ndo_validate_addr = eth_validate_addr, // Use common helper
-    // .ndo_get_stats64 = eth_get_stats64, // If you need 64-bit stats
+    .ndo_get_stats64 = bl702_emac_get_stats64,
 };
 
 // --- Platform Driver Probe/Remove ---
@@ -1066,6 +2803,7 @@ static int bl702_emac_probe(struct platform_device *pdev)
     struct resource *res;
     int irq;
     int ret;
+    int i;
     u8 mac_addr[ETH_ALEN];
     const void *mac_addr_prop;
     int len;
@@ -1081,12 +2819,15 @@ static int bl702_emac_probe(struct platform_device *pdev)
     priv->netdev = netdev;
     priv->dev = &pdev->dev;
 
-    // 2. Get resources from Device Tree
-    res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
-    priv->base_addr = devm_ioremap_resource(&pdev->dev, res);
-    if (IS_ERR(priv->base_addr)) {
-        ret = PTR_ERR(priv->base_addr);
-        goto err_free_netdev;
+    // 2. Get resources from Device Tree, the simulated MAC has no MMIO
+    priv->sim = BL702_EMAC_SIM ? dev_get_platdata(&pdev->dev) : NULL;
+    if (!priv->sim) {
+        res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+        priv->base_addr = devm_ioremap_resource(&pdev->dev, res);
+        if (IS_ERR(priv->base_addr)) {
+            ret = PTR_ERR(priv->base_addr);
+            goto err_free_netdev;
+        }
     }
 
     irq = platform_get_irq(pdev, 0);
@@ -1112,9 +2853,45 @@ static int bl702_emac_probe(struct platform_device *pdev)
 
     // 3. Setup net_device operations
     netdev->netdev_ops = &bl702_emac_netdev_ops;
+    netdev->ethtool_ops = &bl702_emac_ethtool_ops;
+    // Frames may span several BDs, so paged skbs go out without a copy. Checksums
+    // and TSO are done by the driver, see bl702_emac_tx_map_tso()
+    netdev->hw_features |= NETIF_F_SG | NETIF_F_IP_CSUM | NETIF_F_IPV6_CSUM |
+                           NETIF_F_TSO | NETIF_F_TSO6 | NETIF_F_RXCSUM;
+    netdev->features |= netdev->hw_features;
+    netdev->max_mtu = BL702_MAX_MTU;
+    netdev->xdp_features = NETDEV_XDP_ACT_BASIC | NETDEV_XDP_ACT_REDIRECT |
+                           NETDEV_XDP_ACT_NDO_XMIT | NETDEV_XDP_ACT_XSK_ZEROCOPY;
+
+    // Segment headers are built per TX BD, in a pool sized for the largest TX ring
+    priv->tso_hdrs = dmam_alloc_coherent(&pdev->dev, BL702_BD_TOTAL * TSO_HEADER_SIZE,
+                                         &priv->tso_hdrs_dma, GFP_KERNEL);
+    if (!priv->tso_hdrs) {
+        ret = -ENOMEM;
+        goto err_free_netdev;
+    }
+    priv->rx_copybreak = BL702_RX_COPYBREAK_DEFAULT;
+    priv->tx_ring_size = EMAC_TX_BD_BUM_MAX;
+    priv->rx_ring_size = EMAC_RX_BD_BUM_MAX;
+    priv->tx_coal_frames = BL702_TX_COAL_FRAMES;
+    priv->tx_coal_usecs = BL702_TX_COAL_USECS;
+    priv->rx_coal_frames = BL702_RX_COAL_FRAMES;
+    priv->rx_coal_usecs = BL702_RX_COAL_USECS;
+    hrtimer_init(&priv->tx_coal_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    priv->tx_coal_timer.function = bl702_emac_tx_coal_timer;
+    hrtimer_init(&priv->rx_coal_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_PINNED);
+    priv->rx_coal_timer.function = bl702_emac_rx_coal_timer;
+    priv->rx_dim_enabled = true;
+    priv->rx_dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
+    INIT_WORK(&priv->rx_dim.work, bl702_emac_rx_dim_work);
+    for (i = 0; i < BL702_NUM_QUEUES; i++) {
+        u64_stats_init(&priv->napi_stats[i].syncp);
+        u64_stats_init(&priv->xmit_stats[i].syncp);
+    }
+    u64_stats_init(&priv->irq_stats.syncp);
 
     // 4. Initialize NAPI
-    netif_napi_add(netdev, &priv->napi, bl702_emac_poll, 1518); // NAPI weight (budget)
+    netif_napi_add(netdev, &priv->napi, bl702_emac_poll); // Default weight, NAPI_POLL_WEIGHT
 
     // 6. Register net_device
     ret = register_netdev(netdev);
@@ -0,0 +1,444 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Host-side model of the BL702 EMAC, to run the driver without the board
+ *
+ * Registers two "bl702-emac" platform devices. Their register file, BD memory
+ * and MDIO bus with one PHY live in RAM, and their interrupt line is an irq_sim
+ * interrupt. Frames one device transmits arrive on the other's RX ring, like a
+ * veth pair; loopback=1 wires each device to itself instead. The driver must be
+ * built with BL702_EMAC_SIM=1, see the Makefile and sim_bench.sh.
+ *
+ * The model reaches the driver's buffers through the linear map, so it assumes
+ * DMA addresses are physical addresses: no IOMMU, as on a stock x86 kernel or
+ * a QEMU guest. BDs hold 32-bit addresses, give the guest less than 4 GiB so
+ * frames are not bounced through swiotlb.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/platform_device.h>
+#include <linux/dma-mapping.h>
+#include <linux/etherdevice.h>
+#include <linux/crc32.h>
+#include <linux/mii.h>
+#include <linux/irq.h>
+#include <linux/irqdomain.h>
+#include <linux/irq_sim.h>
+#include <linux/interrupt.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/bitfield.h>
+#include <linux/slab.h>
+#include <linux/io.h>
+
+#include "emac_reg.h"
+#include "bl702_emac_sim.h"
+
+// The devices bind to the driver by its platform driver name
+#define DRV_NAME "bl702-emac"
+#define BL702_SIM_DEVICES 2
+#define BL702_SIM_REGS (EMAC_TXCTRL_OFFSET / 4 + 1)
+// BD memory 0x400-0x7FF, 128 BDs of two words
+#define BL702_SIM_BDS 128
+// The BD length field is 16 bits, so is the largest frame the model gathers
+#define BL702_SIM_FRAME_MAX 0x10000
+// Frames sent per lock hold, the driver's register accesses wait meanwhile
+#define BL702_SIM_TX_BATCH 16
+#define BL702_SIM_PHY_ID1 0x0b70
+#define BL702_SIM_PHY_ID2 0x2000
+
+static bool loopback;
+module_param(loopback, bool, 0444);
+MODULE_PARM_DESC(loopback, "Deliver each device's frames to its own RX ring instead of the other device's");
+
+static int phy_addr;
+module_param(phy_addr, int, 0444);
+MODULE_PARM_DESC(phy_addr, "MDIO address of the simulated PHY, other addresses read 0xffff");
+
+struct bl702_sim_dev {
+    struct platform_device *pdev;
+    struct bl702_sim_dev *peer;
+    unsigned int virq;
+
+    u32 regs[BL702_SIM_REGS];
+    u32 bd[BL702_SIM_BDS * 2];
+    unsigned int tx_bd_num; // EMAC_TX_BD_NUM, RX BDs follow the TX BDs
+    unsigned int tx_ptr; // TX BD the MAC sends next
+    unsigned int rx_idx; // RX BD the MAC fills next, relative to the first RX BD
+    u16 phy[32];
+
+    struct work_struct tx_work; // The MAC's TX DMA
+    u8 *frame; // TX frame gathered from its BDs
+};
+
+// One lock for every device: the TX side of one device fills the other's RX ring
+static DEFINE_SPINLOCK(bl702_sim_lock);
+static struct bl702_sim_dev bl702_sim_devs[BL702_SIM_DEVICES];
+static struct irq_domain *bl702_sim_domain;
+static struct fwnode_handle *bl702_sim_fwnode;
+
+static void bl702_sim_phy_reset(struct bl702_sim_dev *sd)
+{
+    memset(sd->phy, 0, sizeof(sd->phy));
+    sd->phy[MII_BMCR] = BMCR_ANENABLE | BMCR_SPEED100 | BMCR_FULLDPLX;
+    sd->phy[MII_BMSR] = BMSR_100FULL | BMSR_100HALF | BMSR_10FULL | BMSR_10HALF |
+                        BMSR_ANEGCAPABLE | BMSR_ANEGCOMPLETE | BMSR_LSTATUS;
+    sd->phy[MII_PHYSID1] = BL702_SIM_PHY_ID1;
+    sd->phy[MII_PHYSID2] = BL702_SIM_PHY_ID2;
+    sd->phy[MII_ADVERTISE] = ADVERTISE_ALL | ADVERTISE_CSMA;
+    sd->phy[MII_LPA] = LPA_100FULL | LPA_100HALF | LPA_10FULL | LPA_10HALF | LPA_LPACK |
+                       ADVERTISE_CSMA;
+}
+
+// MDIO transactions complete at once, MIISTATUS never reads busy
+static void bl702_sim_mdio(struct bl702_sim_dev *sd, u32 cmd)
+{
+    u32 addr = sd->regs[EMAC_MIIADDRESS_OFFSET / 4];
+    unsigned int fiad = FIELD_GET(EMAC_FIAD_MASK, addr);
+    unsigned int rgad = FIELD_GET(EMAC_RGAD_MASK, addr);
+    u16 val;
+
+    if (cmd & EMAC_RSTAT) {
+        val = fiad == phy_addr ? sd->phy[rgad] : 0xffff;
+        sd->regs[EMAC_MIIRX_DATA_OFFSET / 4] = FIELD_PREP(EMAC_PRSD_MASK, val);
+    }
+    if ((cmd & EMAC_WCTRLDATA) && fiad == phy_addr) {
+        val = FIELD_GET(EMAC_CTRLDATA_MASK, sd->regs[EMAC_MIITX_DATA_OFFSET / 4]);
+        if (rgad == MII_BMCR && (val & BMCR_RESET))
+            bl702_sim_phy_reset(sd);
+        else if (rgad == MII_BMCR)
+            sd->phy[rgad] = val & ~BMCR_ANRESTART;
+        else if (rgad != MII_BMSR && rgad != MII_PHYSID1 && rgad != MII_PHYSID2)
+            sd->phy[rgad] = val;
+    }
+}
+
+// Raise INT_SOURCE bits, the line fires when a newly set source is enabled.
+// A set INT_MASK bit enables the source.
+static void bl702_sim_raise(struct bl702_sim_dev *sd, u32 bits)
+{
+    u32 *src = &sd->regs[EMAC_INT_SOURCE_OFFSET / 4];
+    u32 mask = sd->regs[EMAC_INT_MASK_OFFSET / 4];
+    u32 before = *src & mask;
+
+    *src |= bits;
+    if ((*src & mask) & ~before)
+        irq_set_irqchip_state(sd->virq, IRQCHIP_STATE_PENDING, true);
+}
+
+static bool bl702_sim_rx_match(struct bl702_sim_dev *sd, const u8 *da)
+{
+    u32 mode = sd->regs[EMAC_MODE_OFFSET / 4];
+    u32 addr0 = sd->regs[EMAC_MAC_ADDR0_OFFSET / 4];
+    u32 addr1 = sd->regs[EMAC_MAC_ADDR1_OFFSET / 4];
+    u8 mac[ETH_ALEN];
+    u32 bit;
+
+    if (mode & EMAC_PRO)
+        return true;
+    if (is_broadcast_ether_addr(da))
+        return mode & EMAC_BRO;
+    if (is_multicast_ether_addr(da)) {
+        bit = ether_crc(ETH_ALEN, da) >> 26;
+        return sd->regs[(bit >> 5 ? EMAC_HASH1_ADDR_OFFSET : EMAC_HASH0_ADDR_OFFSET) / 4] &
+               BIT(bit & 31);
+    }
+
+    mac[0] = addr1 >> EMAC_MAC_B0_SHIFT;
+    mac[1] = addr1 >> EMAC_MAC_B1_SHIFT;
+    mac[2] = addr0 >> EMAC_MAC_B2_SHIFT;
+    mac[3] = addr0 >> EMAC_MAC_B3_SHIFT;
+    mac[4] = addr0 >> EMAC_MAC_B4_SHIFT;
+    mac[5] = addr0 >> EMAC_MAC_B5_SHIFT;
+    return ether_addr_equal(da, mac);
+}
+
+// Receive one frame into the next RX BD, appending the FCS like the MAC does
+static void bl702_sim_rx_frame(struct bl702_sim_dev *sd, const u8 *frame, unsigned int len)
+{
+    u32 mode = sd->regs[EMAC_MODE_OFFSET / 4];
+    unsigned int maxfl = FIELD_GET(EMAC_MAXFL_MASK, sd->regs[EMAC_PACKETLEN_OFFSET / 4]);
+    unsigned int bd_idx = sd->tx_bd_num + sd->rx_idx;
+    u32 *bd = &sd->bd[bd_idx * 2];
+    unsigned int flen = len + ETH_FCS_LEN;
+    u32 status = 0;
+    __le32 fcs;
+    u8 *buf;
+
+    if (!(mode & EMAC_RX_EN) || bd_idx >= BL702_SIM_BDS || !bl702_sim_rx_match(sd, frame))
+        return;
+
+    // No empty BD: the frame is lost, as on the MAC
+    if (!(bd[0] & EMAC_BD_RX_E_MASK)) {
+        bl702_sim_raise(sd, EMAC_BUSY);
+        return;
+    }
+
+    if (flen > maxfl && !(mode & EMAC_HUGEN)) {
+        status |= EMAC_BD_RX_TL_MASK;
+        flen = maxfl;
+    }
+    buf = phys_to_virt(bd[1]);
+    memcpy(buf, frame, min(len, flen));
+    if (flen == len + ETH_FCS_LEN) {
+        fcs = cpu_to_le32(~crc32_le(~0, frame, len));
+        memcpy(buf + len, &fcs, ETH_FCS_LEN);
+    }
+
+    bd[0] = (bd[0] & (EMAC_BD_RX_WR_MASK | EMAC_BD_RX_IRQ_MASK)) |
+            FIELD_PREP(EMAC_BD_RX_LEN_MASK, flen) | status;
+    if (bd[0] & EMAC_BD_RX_IRQ_MASK)
+        bl702_sim_raise(sd, status ? EMAC_RXE : EMAC_RXB);
+
+    if ((bd[0] & EMAC_BD_RX_WR_MASK) || bd_idx + 1 == BL702_SIM_BDS)
+        sd->rx_idx = 0;
+    else
+        sd->rx_idx++;
+}
+
+// Send one frame from tx_ptr. Returns false when the MAC has nothing (complete) to send.
+static bool bl702_sim_tx_frame(struct bl702_sim_dev *sd)
+{
+    unsigned int idx = sd->tx_ptr, len = 0, seg;
+    bool irq = false;
+    u32 first = sd->bd[idx * 2], w0;
+
+    // Gather the frame, all of its BDs must be ready before any is sent
+    do {
+        w0 = sd->bd[idx * 2];
+        if (!(w0 & EMAC_BD_TX_RD_MASK))
+            return false;
+        seg = FIELD_GET(EMAC_BD_TX_LEN_MASK, w0);
+        if (len + seg > BL702_SIM_FRAME_MAX)
+            seg = BL702_SIM_FRAME_MAX - len;
+        memcpy(sd->frame + len, phys_to_virt(sd->bd[idx * 2 + 1]), seg);
+        len += seg;
+        if ((w0 & EMAC_BD_TX_WR_MASK) || idx + 1 >= sd->tx_bd_num)
+            idx = 0;
+        else
+            idx++;
+    } while (!(w0 & EMAC_BD_TX_EOF_MASK) && idx != sd->tx_ptr);
+
+    if (len < ETH_ZLEN && (first & EMAC_BD_TX_PAD_MASK)) {
+        memset(sd->frame + len, 0, ETH_ZLEN - len);
+        len = ETH_ZLEN;
+    }
+    if (len >= ETH_HLEN)
+        bl702_sim_rx_frame(loopback ? sd : sd->peer, sd->frame, len);
+
+    // Hand the BDs back, a clear status means sent without error
+    while (sd->tx_ptr != idx) {
+        w0 = sd->bd[sd->tx_ptr * 2];
+        irq |= w0 & EMAC_BD_TX_IRQ_MASK;
+        sd->bd[sd->tx_ptr * 2] = w0 & (EMAC_BD_TX_LEN_MASK | EMAC_BD_TX_EOF_MASK |
+                                       EMAC_BD_TX_CRC_MASK | EMAC_BD_TX_PAD_MASK |
+                                       EMAC_BD_TX_WR_MASK | EMAC_BD_TX_IRQ_MASK);
+        if ((w0 & EMAC_BD_TX_WR_MASK) || sd->tx_ptr + 1 >= sd->tx_bd_num)
+            sd->tx_ptr = 0;
+        else
+            sd->tx_ptr++;
+    }
+    if (irq)
+        bl702_sim_raise(sd, EMAC_TXB);
+    return true;
+}
+
+static void bl702_sim_tx_work(struct work_struct *work)
+{
+    struct bl702_sim_dev *sd = container_of(work, struct bl702_sim_dev, tx_work);
+    unsigned long flags;
+    bool more = true;
+    int n;
+
+    while (more) {
+        spin_lock_irqsave(&bl702_sim_lock, flags);
+        for (n = 0; n < BL702_SIM_TX_BATCH; n++) {
+            more = (sd->regs[EMAC_MODE_OFFSET / 4] & EMAC_TX_EN) && sd->tx_bd_num &&
+                   bl702_sim_tx_frame(sd);
+            if (!more)
+                break;
+        }
+        spin_unlock_irqrestore(&bl702_sim_lock, flags);
+        cond_resched();
+    }
+}
+
+static u32 bl702_sim_readl(void *ctx, unsigned long offset)
+{
+    struct bl702_sim_dev *sd = ctx;
+    unsigned long flags;
+    u32 val = 0;
+
+    spin_lock_irqsave(&bl702_sim_lock, flags);
+    if (offset >= EMAC_DMA_DESC_OFFSET)
+        val = sd->bd[(offset - EMAC_DMA_DESC_OFFSET) / 4 % ARRAY_SIZE(sd->bd)];
+    else if (offset == EMAC_TX_BD_NUM_OFFSET)
+        val = FIELD_PREP(EMAC_TXBDNUM_MASK, sd->tx_bd_num) |
+              FIELD_PREP(EMAC_TXBDPTR_MASK, sd->tx_ptr) |
+              FIELD_PREP(EMAC_RXBDPTR_MASK, sd->tx_bd_num + sd->rx_idx);
+    else if (offset == EMAC_MIISTATUS_OFFSET || offset == EMAC_MIICOMMAND_OFFSET)
+        val = 0;
+    else if (offset / 4 < BL702_SIM_REGS)
+        val = sd->regs[offset / 4];
+    spin_unlock_irqrestore(&bl702_sim_lock, flags);
+    return val;
+}
+
+static void bl702_sim_writel(void *ctx, u32 val, unsigned long offset)
+{
+    struct bl702_sim_dev *sd = ctx;
+    unsigned long flags;
+    bool kick = false;
+    u32 *reg;
+
+    spin_lock_irqsave(&bl702_sim_lock, flags);
+    if (offset >= EMAC_DMA_DESC_OFFSET) {
+        unsigned int word = (offset - EMAC_DMA_DESC_OFFSET) / 4 % ARRAY_SIZE(sd->bd);
+
+        sd->bd[word] = val;
+        // A TX BD turned ready, the MAC picks it up if it is the next one
+        kick = !(word & 1) && word / 2 < sd->tx_bd_num && (val & EMAC_BD_TX_RD_MASK);
+        goto out;
+    }
+    if (offset / 4 >= BL702_SIM_REGS)
+        goto out;
+
+    reg = &sd->regs[offset / 4];
+    switch (offset) {
+    case EMAC_MODE_OFFSET:
+        if ((*reg & EMAC_TX_EN) && !(val & EMAC_TX_EN))
+            sd->tx_ptr = 0;
+        if ((*reg & EMAC_RX_EN) && !(val & EMAC_RX_EN))
+            sd->rx_idx = 0;
+        *reg = val;
+        kick = val & EMAC_TX_EN;
+        break;
+    case EMAC_INT_SOURCE_OFFSET:
+        *reg &= ~val; // Write one to clear
+        break;
+    case EMAC_INT_MASK_OFFSET:
+        *reg = val;
+        bl702_sim_raise(sd, 0);
+        break;
+    case EMAC_TX_BD_NUM_OFFSET:
+        sd->tx_bd_num = min_t(unsigned int, FIELD_GET(EMAC_TXBDNUM_MASK, val), BL702_SIM_BDS);
+        sd->tx_ptr = 0;
+        sd->rx_idx = 0;
+        break;
+    case EMAC_MIICOMMAND_OFFSET:
+        bl702_sim_mdio(sd, val);
+        break;
+    default:
+        *reg = val;
+        break;
+    }
+out:
+    spin_unlock_irqrestore(&bl702_sim_lock, flags);
+    if (kick)
+        queue_work(system_highpri_wq, &sd->tx_work);
+}
+
+static int bl702_sim_add(struct bl702_sim_dev *sd, int id)
+{
+    struct bl702_emac_sim_pdata pdata = {
+        .readl = bl702_sim_readl,
+        .writel = bl702_sim_writel,
+        .ctx = sd,
+    };
+    struct resource res = { .flags = IORESOURCE_IRQ };
+    struct platform_device_info info = {
+        .name = DRV_NAME,
+        .id = id,
+        .res = &res,
+        .num_res = 1,
+        .data = &pdata,
+        .size_data = sizeof(pdata),
+        .dma_mask = DMA_BIT_MASK(32),
+    };
+
+    sd->frame = kmalloc(BL702_SIM_FRAME_MAX, GFP_KERNEL);
+    if (!sd->frame)
+        return -ENOMEM;
+
+    sd->virq = irq_create_mapping(bl702_sim_domain, id);
+    if (!sd->virq)
+        return -ENXIO;
+    res.start = sd->virq;
+    res.end = sd->virq;
+
+    INIT_WORK(&sd->tx_work, bl702_sim_tx_work);
+    bl702_sim_phy_reset(sd);
+    sd->peer = &bl702_sim_devs[id ^ 1];
+
+    sd->pdev = platform_device_register_full(&info);
+    if (IS_ERR(sd->pdev)) {
+        int ret = PTR_ERR(sd->pdev);
+
+        sd->pdev = NULL;
+        return ret;
+    }
+    return 0;
+}
+
+static void bl702_sim_del(struct bl702_sim_dev *sd)
+{
+    // Unbinding the driver stops the MAC, no new TX work is queued after this
+    if (sd->pdev)
+        platform_device_unregister(sd->pdev);
+    cancel_work_sync(&sd->tx_work);
+    if (sd->virq)
+        irq_dispose_mapping(sd->virq);
+    kfree(sd->frame);
+}
+
+static void bl702_sim_cleanup(void)
+{
+    int i;
+
+    for (i = 0; i < BL702_SIM_DEVICES; i++)
+        bl702_sim_del(&bl702_sim_devs[i]);
+    irq_domain_remove_sim(bl702_sim_domain);
+    irq_domain_free_fwnode(bl702_sim_fwnode);
+}
+
+static int __init bl702_sim_init(void)
+{
+    int ret;
+    int i;
+
+    bl702_sim_fwnode = irq_domain_alloc_named_fwnode("bl702-emac-sim");
+    if (!bl702_sim_fwnode)
+        return -ENOMEM;
+
+    bl702_sim_domain = irq_domain_create_sim(bl702_sim_fwnode, BL702_SIM_DEVICES);
+    if (IS_ERR(bl702_sim_domain)) {
+        irq_domain_free_fwnode(bl702_sim_fwnode);
+        return PTR_ERR(bl702_sim_domain);
+    }
+
+    for (i = 0; i < BL702_SIM_DEVICES; i++) {
+        ret = bl702_sim_add(&bl702_sim_devs[i], i);
+        if (ret) {
+            bl702_sim_cleanup();
+            return ret;
+        }
+    }
+
+    pr_info("%d simulated EMACs, %s\n", BL702_SIM_DEVICES,
+            loopback ? "each looped back to itself" : "wired to each other");
+    return 0;
+}
+
+static void __exit bl702_sim_exit(void)
+{
+    bl702_sim_cleanup();
+}
+
+module_init(bl702_sim_init);
+module_exit(bl702_sim_exit);
+
+MODULE_AUTHOR("Vishnu S");
+MODULE_DESCRIPTION("Host-side model of the BL702 EMAC for driver testing");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Interface between the BL702 EMAC driver and the host-side EMAC model
+ * (bl702_emac_sim.c). The model registers "bl702-emac" platform devices with
+ * this as platform data, and a driver built with BL702_EMAC_SIM=1 sends its
+ * register and BD accesses here instead of to MMIO.
+ */
+
+#ifndef __BL702_EMAC_SIM_H__
+#define __BL702_EMAC_SIM_H__
+
+#include <linux/types.h>
+
+struct bl702_emac_sim_pdata {
+    u32 (*readl)(void *ctx, unsigned long offset);
+    void (*writel)(void *ctx, u32 val, unsigned long offset);
+    void *ctx;
+};
+
+#endif /* __BL702_EMAC_SIM_H__ */
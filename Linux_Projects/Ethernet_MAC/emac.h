@@ -11,6 +11,7 @@
 #define EMAC_REG_SIZE       0x1000   
 #define EMAC_DO_FLUSH_DATA (1)
 
+/* Not used: the BL702 and FLC EMACs have a single TX/RX BD ring pair, one queue each */
 #define EMAC_MAX_QUEUES 8
 
 
@@ -140,6 +141,10 @@ struct emac_priv {
     u8 rx_index_emac;
     u8 rx_index_cpu;
     u8 rx_buff_limit;
+
+    /* Frames above tx_copybreak are sent from the skb, which the BD owns until done */
+    struct sk_buff *tx_skb[EMAC_TX_DESC_NUM];
+    dma_addr_t tx_skb_dma[EMAC_TX_DESC_NUM];
     
     /* Locking */
     spinlock_t lock;
@@ -166,7 +171,6 @@ struct emac_priv {
     unsigned long rx_packets;
     unsigned long tx_packets;
 };
-static int emac_phylink_connect(struct emac_priv *priv);
 static int emac_init_bd_list(struct emac_priv *priv);
 static void emac_reset_hw(struct emac_priv *priv);
 static void emac_free_bd_list(struct emac_priv *priv);
@@ -11,9 +11,23 @@
 #include <linux/of_mdio.h>
 #include <linux/of_net.h>
 #include <linux/mdio.h>
+#include <linux/crc32.h>
+#include <linux/iopoll.h>
 #define DRIVER_NAME "flc_emac"
 #define EMAC_MAX_FRAME_LENGTH   (0x600)
 #define EMAC_MIN_FRAME_LENGTH   (0x40)
+/* One MDIO frame is 64 MDC cycles, about 26us at 2.5MHz */
+#define EMAC_MDIO_POLL_US       (20)
+#define EMAC_MDIO_TIMEOUT_US    (10000)
+
+/* Frames up to tx_copybreak bytes are copied into the BD's coherent slot and
+ * the skb is freed at once, longer frames are DMA mapped. Tune it with
+ * rx_bench.sh txcross.
+ */
+static unsigned int tx_copybreak = 256;
+module_param(tx_copybreak, uint, 0644);
+MODULE_PARM_DESC(tx_copybreak, "Copy TX frames up to this length instead of mapping them");
+
 static int emac_open(struct net_device *ndev)
 {
     struct emac_priv *priv = netdev_priv(ndev);
@@ -21,32 +35,36 @@ static int emac_open(struct net_device *ndev)
 
     pr_info("EMAC: open called\n");
 
-    if (!priv->mii_phy) {
-        dev_err(priv->dev, "rmii_phy is NULL! Cannot power on PHY.\n");
-        return -ENODEV;
-    }
-
+    /* the generic PHY (mii_phy) is optional, phy_power_on() accepts NULL */
     err = phy_power_on(priv->mii_phy);
     if (err)
-        goto reset_hw;
-
-    err = emac_phylink_connect(priv);
-    if (err)
-        goto phy_off;
+        return err;
 
     err = emac_init_bd_list(priv);
     if (err) {
         dev_err(priv->dev, "Failed to initialize BD list\n");
-        return err;
+        goto reset_hw;
     }
 
+    /* Enable TX done/error interrupts (a set INT_MASK bit enables) and the transmitter */
+    writel(EMAC_INT_STS_ALL, priv->base + EMAC_INT_SOURCE_OFFSET);
+    writel(EMAC_TXB_M | EMAC_TXE_M, priv->base + EMAC_INT_MASK_OFFSET);
+    writel(readl(priv->base + EMAC_MODE_OFFSET) | EMAC_TX_EN, priv->base + EMAC_MODE_OFFSET);
+
+    /* The PHY was connected in emac_mii_probe(). With an interrupt in its DT
+     * node phylib only reads it when the PHY signals a change, else it polls.
+     * Some PHYs need a reset once their clock runs.
+     */
+    if (phy_reset_after_clk_enable(ndev->phydev) == 1)
+        phy_init_hw(ndev->phydev);
+    phy_start(ndev->phydev);
+
     netif_start_queue(ndev);
     return 0;
 
 reset_hw:
     emac_reset_hw(priv);
     emac_free_bd_list(priv);
-phy_off:
     phy_power_off(priv->mii_phy);
     return err;
 }
@@ -56,89 +74,168 @@ static int emac_stop(struct net_device *ndev)
    struct emac_priv *priv = netdev_priv(ndev);
 
     netif_stop_queue(ndev);
+    phy_stop(ndev->phydev);
 
     emac_reset_hw(priv);
     emac_free_bd_list(priv);
+    phy_power_off(priv->mii_phy);
 	
     return 0;
 }
 
-static netdev_tx_t emac_start_xmit(struct sk_buff *skb, struct net_device *ndev)
+/* Free TX BDs, one is kept unused so a full ring differs from an empty one */
+static unsigned int emac_tx_space(struct emac_priv *priv)
 {
-    pr_info("EMAC: start_xmit called (dropping packet for now)\n");
-    dev_kfree_skb(skb);  // Just drop packets for now
-    return NETDEV_TX_OK;
+    return EMAC_TX_DESC_NUM - 1 -
+           (priv->tx_index_cpu + EMAC_TX_DESC_NUM - priv->tx_index_emac) % EMAC_TX_DESC_NUM;
 }
 
-irqreturn_t emac_interrupt_handler(int irq, void *dev_id)
+static void emac_tx_unmap(struct emac_priv *priv, u8 i)
 {
-    //struct net_device *ndev = dev_id;
-   // struct emac_priv *priv = netdev_priv(ndev);
+    struct sk_buff *skb = priv->tx_skb[i];
 
-    // TODO: Clear IRQ status, process RX/TX
-
-    return IRQ_HANDLED;
+    if (!skb)
+        return;
+    dma_unmap_single(priv->dev, priv->tx_skb_dma[i], skb->len, DMA_TO_DEVICE);
+    dev_consume_skb_any(skb);
+    priv->tx_skb[i] = NULL;
 }
-static bool emac_phy_handle_exists(struct device_node *dn)
+
+/* Reclaim sent BDs, called with priv->lock held */
+static void emac_tx_complete(struct emac_priv *priv)
 {
-	dn = of_parse_phandle(dn, "phy-handle", 0);
-	of_node_put(dn);
-	return dn != NULL;
+    struct net_device *ndev = priv->ndev;
+    u32 c_s_l;
+    u8 i;
+
+    while (priv->tx_index_emac != priv->tx_index_cpu) {
+        i = priv->tx_index_emac;
+        c_s_l = READ_ONCE(priv->bd_base[i].c_s_l);
+        if (c_s_l & EMAC_BD_TX_RD_MASK)
+            break;
+
+        if (c_s_l & (EMAC_BD_TX_CS_MASK | EMAC_BD_TX_LC_MASK |
+                     EMAC_BD_TX_RL_MASK | EMAC_BD_TX_UR_MASK))
+            ndev->stats.tx_errors++;
+
+        /* Copied frames have no skb left, their slot is simply reused */
+        emac_tx_unmap(priv, i);
+        priv->tx_index_emac = NEXT_INDEX(i, EMAC_TX_DESC_NUM);
+    }
+
+    if (netif_queue_stopped(ndev) && emac_tx_space(priv))
+        netif_wake_queue(ndev);
 }
 
-static int emac_phylink_connect(struct emac_priv *priv)
+static netdev_tx_t emac_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 {
-	struct device_node *dn = priv->pdev->dev.of_node;
-	struct net_device *ndev = priv->ndev;
-	struct phy_device *phydev;
-	int ret;
+    struct emac_priv *priv = netdev_priv(ndev);
+    struct emac_bd_desc *bd;
+    unsigned int len = skb->len;
+    unsigned long flags;
+    dma_addr_t dma;
+    u32 c_s_l;
+    u8 i;
+
+    if (len > ETH_MAX_PKT_LEN) {
+        ndev->stats.tx_dropped++;
+        dev_kfree_skb_any(skb);
+        return NETDEV_TX_OK;
+    }
 
-	if (dn)
-		ret = phylink_of_phy_connect(priv->phylink, dn, 0);
+    spin_lock_irqsave(&priv->lock, flags);
 
-	if (!dn || (ret && !emac_phy_handle_exists(dn))) {
-		phydev = phy_find_first(priv->mii_bus);
-		if (!phydev) {
-			netdev_err(ndev, "no PHY found\n");
-			return -ENXIO;
-		}
+    if (!emac_tx_space(priv)) {
+        netif_stop_queue(ndev);
+        spin_unlock_irqrestore(&priv->lock, flags);
+        return NETDEV_TX_BUSY;
+    }
 
-		/* attach the mac to the phy */
-		ret = phylink_connect_phy(priv->phylink, phydev);
-	}
+    i = priv->tx_index_cpu;
+    bd = &priv->bd_base[i];
+
+    if (len <= tx_copybreak) {
+        /* Small frame: copy into this BD's slot, no mapping and no skb to keep */
+        dma = priv->tx_dma + i * ETH_MAX_PKT_LEN;
+        skb_copy_bits(skb, 0, priv->tx_bufs + i * ETH_MAX_PKT_LEN, len);
+        dev_consume_skb_any(skb);
+    } else {
+        dma = dma_map_single(priv->dev, skb->data, len, DMA_TO_DEVICE);
+        if (dma_mapping_error(priv->dev, dma)) {
+            spin_unlock_irqrestore(&priv->lock, flags);
+            ndev->stats.tx_dropped++;
+            dev_kfree_skb_any(skb);
+            return NETDEV_TX_OK;
+        }
+        priv->tx_skb[i] = skb;
+        priv->tx_skb_dma[i] = dma;
+    }
 
-	if (ret) {
-		netdev_err(ndev, "Could not attach PHY (%d)\n", ret);
-		return ret;
-	}
+    bd->buffer = dma;
+    c_s_l = (len << EMAC_BD_TX_LEN_SHIFT) | EMAC_BD_TX_EOF_MASK | EMAC_BD_TX_CRC_MASK |
+            EMAC_BD_TX_PAD_MASK | EMAC_BD_TX_IRQ_MASK | EMAC_BD_TX_RD_MASK;
+    if (i == EMAC_TX_DESC_NUM - 1)
+        c_s_l |= EMAC_BD_TX_WR_MASK;
 
-	/* Since this driver uses runtime handling of clocks, initiate a phy
-	 * reset if the attached phy requires it. Check return to see if phy
-	 * was reset and then do a phy initialization.
-	 */
-	if (phy_reset_after_clk_enable(ndev->phydev) == 1)
-		phy_init_hw(ndev->phydev);
+    /* Buffer address and data must be visible before the MAC sees RD */
+    dma_wmb();
+    WRITE_ONCE(bd->c_s_l, c_s_l);
 
-	phylink_start(priv->phylink);
+    priv->tx_index_cpu = NEXT_INDEX(i, EMAC_TX_DESC_NUM);
+    ndev->stats.tx_packets++;
+    ndev->stats.tx_bytes += len;
 
-	return 0;
+    if (!emac_tx_space(priv))
+        netif_stop_queue(ndev);
+
+    spin_unlock_irqrestore(&priv->lock, flags);
+    return NETDEV_TX_OK;
 }
 
+irqreturn_t emac_interrupt_handler(int irq, void *dev_id)
+{
+    struct net_device *ndev = dev_id;
+    struct emac_priv *priv = netdev_priv(ndev);
+    u32 status;
+
+    status = readl(priv->base + EMAC_INT_SOURCE_OFFSET);
+    if (!status)
+        return IRQ_NONE;
+    writel(status, priv->base + EMAC_INT_SOURCE_OFFSET);
+
+    if (status & (EMAC_TXB | EMAC_TXE)) {
+        spin_lock(&priv->lock);
+        emac_tx_complete(priv);
+        spin_unlock(&priv->lock);
+    }
+
+    // TODO: process RX
+
+    return IRQ_HANDLED;
+}
 static void emac_free_bd_list(struct emac_priv *priv)
 {
     struct net_device *ndev = priv->ndev;
     size_t bd_total_size = EMAC_DESC_NUM_TOTAL * sizeof(struct emac_bd_desc);
     size_t tx_buf_size = EMAC_TX_DESC_NUM * ETH_MAX_PKT_LEN;
     size_t rx_buf_size = EMAC_RX_DESC_NUM * ETH_MAX_PKT_LEN;
+    int i;
 
     netif_stop_queue(ndev);
 
+    /* The MAC is stopped, frames still on the ring are dropped */
+    for (i = 0; i < EMAC_TX_DESC_NUM; i++)
+        emac_tx_unmap(priv, i);
+
     if (priv->bd_base)
         dma_free_coherent(priv->dev, bd_total_size, priv->bd_base, priv->bd_dma);
     if (priv->tx_bufs)
         dma_free_coherent(priv->dev, tx_buf_size, priv->tx_bufs, priv->tx_dma);
     if (priv->rx_bufs)
         dma_free_coherent(priv->dev, rx_buf_size, priv->rx_bufs, priv->rx_dma);
+    priv->bd_base = NULL;
+    priv->tx_bufs = NULL;
+    priv->rx_bufs = NULL;
     netif_stop_queue(ndev);
 
 
@@ -151,6 +248,7 @@ static void emac_reset_hw(struct emac_priv *priv)
     reg = readl(priv->base + EMAC_MODE_OFFSET);
     reg &= ~(EMAC_TX_EN | EMAC_RX_EN);
     writel(reg, priv->base + EMAC_MODE_OFFSET);
+    writel(0, priv->base + EMAC_INT_MASK_OFFSET);
 
     pr_info("EMAC: Hardware reset (TX/RX disabled)\n");
 }
@@ -174,6 +272,8 @@ static int emac_init_bd_list(struct emac_priv *priv)
         return -ENOMEM;
 
     /* Init TX BDs */
+    priv->tx_index_cpu = 0;
+    priv->tx_index_emac = 0;
     for (i = 0; i < EMAC_TX_DESC_NUM; i++) {
         priv->bd_base[i].buffer = priv->tx_dma + (i * ETH_MAX_PKT_LEN);
         priv->bd_base[i].c_s_l = 0;
@@ -195,10 +295,23 @@ static int emac_init_bd_list(struct emac_priv *priv)
 
     return 0;
 }
+/* MDIO accessors run in process context under the bus mutex, so wait for
+ * the MII busy flag by sleeping between polls instead of spinning.
+ */
+static int emac_mdio_wait(struct emac_priv *priv)
+{
+    u32 reg_val;
+
+    return readl_poll_timeout(priv->base + EMAC_MIISTATUS_OFFSET, reg_val,
+                              !(reg_val & EMAC_MIIM_BUSY),
+                              EMAC_MDIO_POLL_US, EMAC_MDIO_TIMEOUT_US);
+}
+
 static int emac_mdio_read(struct mii_bus *bus, int phy_addr, int regnum)
 {
     struct emac_priv *priv = bus->priv;
     uint32_t reg_val;
+    int err;
 
     reg_val = readl(priv->base + EMAC_MIIADDRESS_OFFSET);
     reg_val &= ~(EMAC_FIAD_MASK | EMAC_RGAD_MASK);
@@ -210,18 +323,19 @@ static int emac_mdio_read(struct mii_bus *bus, int phy_addr, int regnum)
     reg_val |= EMAC_RSTAT;
     writel(reg_val, priv->base + EMAC_MIICOMMAND_OFFSET);
 
-    do {
-        reg_val = readl(priv->base + EMAC_MIISTATUS_OFFSET);
-        udelay(16);
-    } while (reg_val & EMAC_MIIM_BUSY);
-    
-    pr_info("%s and %d\n", __func__, __LINE__);
-    return readl(priv->base + EMAC_MIIRX_DATA_OFFSET);
+    err = emac_mdio_wait(priv);
+    if (err) {
+        dev_err(priv->dev, "MDIO read timeout, phy %d reg %d\n", phy_addr, regnum);
+        return err;
+    }
+
+    return readl(priv->base + EMAC_MIIRX_DATA_OFFSET) & EMAC_PRSD_MASK;
 }
 static int emac_mdio_write(struct mii_bus *bus, int phy_addr, int regnum, u16 val)
 {
     struct emac_priv *priv = bus->priv;
     uint32_t reg_val;
+    int err;
 
     reg_val = readl(priv->base + EMAC_MIIADDRESS_OFFSET);
     reg_val &= ~(EMAC_FIAD_MASK | EMAC_RGAD_MASK);
@@ -230,21 +344,19 @@ static int emac_mdio_write(struct mii_bus *bus, int phy_addr, int regnum, u16 va
     writel(reg_val, priv->base + EMAC_MIIADDRESS_OFFSET);
 
     /* set write data */
-    reg_val = readl((priv-> + EMAC_MIITX_DATA_OFFSET));
+    reg_val = readl(priv->base + EMAC_MIITX_DATA_OFFSET);
     reg_val &= ~EMAC_CTRLDATA_MASK;
     reg_val |= (val << EMAC_CTRLDATA_SHIFT) & EMAC_CTRLDATA_MASK;
-    writel(re_val, priv->base + EMAC_MIITX_DATA_OFFSET);
+    writel(reg_val, priv->base + EMAC_MIITX_DATA_OFFSET);
 
     reg_val = readl(priv->base + EMAC_MIICOMMAND_OFFSET);
     reg_val |= EMAC_WCTRLDATA;
     writel(reg_val, priv->base + EMAC_MIICOMMAND_OFFSET);
 
-    do {
-        reg_val = readl(priv->base + EMAC_MIISTATUS_OFFSET);
-        udelay(16);
-    } while (reg_val & EMAC_MIIM_BUSY);
-    pr_info("%s and %d\n", __func__, __LINE__);
-    return 0;
+    err = emac_mdio_wait(priv);
+    if (err)
+        dev_err(priv->dev, "MDIO write timeout, phy %d reg %d\n", phy_addr, regnum);
+    return err;
 }
 
 static void emac_handle_link_change(struct net_device *ndev)
@@ -370,6 +482,11 @@ static int emac_mii_probe(struct net_device *ndev)
 	/* mask with MAC supported features */
 	phy_set_max_speed(phydev, SPEED_100);
 
+	/* of_mdiobus_register() takes the PHY interrupt from its DT node */
+	if (!phy_interrupt_is_valid(phydev))
+		netdev_info(ndev, "PHY has no interrupt, link is polled every second\n");
+	phy_attached_info(phydev);
+
 
 	priv->link = 0;
 	priv->speed = 0;
@@ -545,7 +662,8 @@ int emac_hw_init(struct emac_priv *priv)
     reg_val &= ~EMAC_FULLD;
      /* enable sent preamble */
     reg_val &= ~EMAC_NOPRE;
-    reg_val = EMAC_PRO | EMAC_BRO | EMAC_PAD | 
+    /* promiscuous mode and the multicast hash follow the netdev flags, see emac_set_rx_mode() */
+    reg_val = EMAC_BRO | EMAC_PAD | 
               EMAC_CRCEN | EMAC_RECSMALL | EMAC_IFG;
     writel(reg_val, priv->base + EMAC_MODE_OFFSET);
     dev_info(priv->dev, "EMAC_MODE: 0x%08x\n", readl(priv->base + EMAC_MODE_OFFSET));
@@ -614,10 +732,40 @@ int emac_hw_init(struct emac_priv *priv)
     return 0;
 }
 
+/* Multicast frames are dropped in hardware unless bit (CRC >> 26) of HASH1:HASH0 is set */
+static void emac_set_rx_mode(struct net_device *ndev)
+{
+    struct emac_priv *priv = netdev_priv(ndev);
+    struct netdev_hw_addr *ha;
+    u32 hash[2] = { 0, 0 };
+    u32 reg_val;
+
+    if (ndev->flags & (IFF_PROMISC | IFF_ALLMULTI)) {
+        hash[0] = 0xFFFFFFFF;
+        hash[1] = 0xFFFFFFFF;
+    } else {
+        netdev_for_each_mc_addr(ha, ndev) {
+            u32 bit = ether_crc(ETH_ALEN, ha->addr) >> 26;
+
+            hash[bit >> 5] |= BIT(bit & 31);
+        }
+    }
+    writel(hash[0], priv->base + EMAC_HASH0_ADDR_OFFSET);
+    writel(hash[1], priv->base + EMAC_HASH1_ADDR_OFFSET);
+
+    reg_val = readl(priv->base + EMAC_MODE_OFFSET);
+    if (ndev->flags & IFF_PROMISC)
+        reg_val |= EMAC_PRO;
+    else
+        reg_val &= ~EMAC_PRO;
+    writel(reg_val, priv->base + EMAC_MODE_OFFSET);
+}
+
 static const struct net_device_ops emac_netdev_ops = { 
     .ndo_open       = emac_open,
     .ndo_stop       = emac_stop,
     .ndo_start_xmit = emac_start_xmit,
+    .ndo_set_rx_mode = emac_set_rx_mode,
 };
 #if 0
 static int emac_probe(struct platform_device *pdev)
@@ -726,6 +874,7 @@ static int emac_probe(struct platform_device *pdev)
     priv->ndev = ndev;
     priv->dev = &pdev->dev;
     priv->pdev = pdev;
+    spin_lock_init(&priv->lock);
 
     res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
     if (!res) {
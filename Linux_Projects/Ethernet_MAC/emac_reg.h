@@ -3,9 +3,6 @@
 
 // Generic index increment macro
 #define NEXT_INDEX(idx, size) (((idx) + 1) % (size))
-/* Value Definitions */
-#define TX_IRQ_PACKET_THRESHOLD   8       
-#define TX_IRQ_TIME_THRESHOLD_NS (10 * 1000 * 1000) 
 /* PACKET LENGTH */
 #define EMAC_MAXFL       (1536)   
 #define EMAC_MINFL       (64)    
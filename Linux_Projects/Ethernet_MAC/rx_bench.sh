@@ -0,0 +1,242 @@
+#!/bin/sh
+# RX benchmark for the BL702 EMAC driver.
+#
+# On the traffic source (any Linux host with pktgen, cabled to the board):
+#   ./rx_bench.sh gen <ifname> <board-mac> [pkt_size] [seconds]
+# On the board, while the source is sending:
+#   ./rx_bench.sh rx <ifname> [seconds]
+#   ./rx_bench.sh drop <ifname> xdp|skb [seconds]
+#   ./rx_bench.sh mmio <ifname> [seconds]
+#   ./rx_bench.sh xsk <ifname> [seconds]
+#   ./rx_bench.sh cache <ifname> [seconds]
+#   ./rx_bench.sh spread <ifname> <hex-cpumask>
+# On a board running emac1.c (flc_emac), cabled to any peer:
+#   ./rx_bench.sh txcross <ifname> <peer-mac> [seconds]
+#
+# "rx" prints received and sent packets/sec, drops, CPU use, the interface's
+# interrupt rate and softirq time over the sample period. Run it against the
+# old and the new driver with the same pkt_size to compare. For a mixed load,
+# send traffic back from the board at the same time (e.g. iperf3 -R).
+#
+# "drop" discards everything received and then runs "rx". With "xdp" the frames
+# are dropped by xdp_drop.bpf.o (see xdp_drop.bpf.c) before any skb exists. With
+# "skb" they are dropped by a tc ingress filter, after the driver has built and
+# delivered the skb. Compare the cpu and softirq figures at the same rate.
+#
+# "mmio" prints register and BD reads and writes per packet (rx + tx). It needs
+# a driver built with BL702_MMIO_STATS set to 1.
+#
+# "xsk" receives in user space, first through an AF_PACKET ring and then through
+# an AF_XDP socket on queue 0 in zero-copy mode, and prints both rates. It runs
+# xsk_bench next to this script, see xsk_bench.c for building it.
+#
+# "cache" counts cache references and misses on all harts with perf stat and
+# prints them per packet (rx + tx). Compare driver builds at the same packet
+# rate; events the CPU does not implement are left out.
+#
+# "spread" moves work off the hart taking the EMAC interrupt, the MAC has only
+# one queue pair. NAPI runs in its own thread, RPS and RFS hand protocol
+# processing to the harts in the mask, nearest to the consuming socket. Run "rx"
+# afterwards and compare the rate and cpu figures with the default setup.
+#
+# "txcross" sends pktgen frames of each size from the board once copied
+# (tx_copybreak at its maximum) and once DMA mapped (tx_copybreak 0), and prints
+# both rates. The largest size where copying still wins is the value to use for
+# tx_copybreak. TX_COPYBREAK names the module parameter file if the module is not
+# loaded as emac1.
+
+usage() {
+	echo "usage: $0 gen <ifname> <dst-mac> [pkt_size] [seconds]"
+	echo "       $0 rx <ifname> [seconds]"
+	echo "       $0 drop <ifname> xdp|skb [seconds]"
+	echo "       $0 mmio <ifname> [seconds]"
+	echo "       $0 xsk <ifname> [seconds]"
+	echo "       $0 cache <ifname> [seconds]"
+	echo "       $0 spread <ifname> <hex-cpumask>"
+	echo "       $0 txcross <ifname> <dst-mac> [seconds]"
+	exit 1
+}
+
+pgset() {
+	echo "$1" > "$PGDEV" || { echo "pktgen: '$1' failed on $PGDEV"; exit 1; }
+}
+
+# pktgen on the sending host, one thread, minimum gap, fixed size UDP frames
+gen() {
+	IF=$1; DST=$2; SIZE=${3:-64}; SECS=${4:-30}
+	[ -n "$IF" ] && [ -n "$DST" ] || usage
+	modprobe pktgen || exit 1
+
+	PGDEV=/proc/net/pktgen/kpktgend_0
+	pgset "rem_device_all"
+	pgset "add_device $IF"
+
+	PGDEV=/proc/net/pktgen/$IF
+	pgset "count 0"
+	pgset "clone_skb 1000"
+	pgset "pkt_size $SIZE"
+	pgset "delay 0"
+	pgset "dst 10.0.0.2"
+	pgset "dst_mac $DST"
+
+	PGDEV=/proc/net/pktgen/pgctrl
+	echo "sending $SIZE byte frames to $DST on $IF for $SECS s"
+	pgset "start" &
+	sleep "$SECS"
+	pgset "stop"
+	grep -A2 "Result" "/proc/net/pktgen/$IF"
+}
+
+# busy, softirq and total jiffies summed over all harts
+cpu_sample() {
+	awk '/^cpu / { print $2+$3+$4+$7+$8, $8, $2+$3+$4+$5+$6+$7+$8 }' /proc/stat
+}
+
+# interrupts taken by the line registered under the interface name, all harts
+irq_sample() {
+	awk -v ifname="$1" '$NF == ifname { for (i = 2; i <= NF; i++) if ($i ~ /^[0-9]+$/) n += $i } END { print n + 0 }' /proc/interrupts
+}
+
+rx() {
+	IF=$1; SECS=${2:-10}
+	[ -n "$IF" ] || usage
+	STATS=/sys/class/net/$IF/statistics
+	[ -d "$STATS" ] || { echo "no such interface: $IF"; exit 1; }
+
+	P0=$(cat "$STATS/rx_packets"); B0=$(cat "$STATS/rx_bytes"); D0=$(cat "$STATS/rx_dropped")
+	T0=$(cat "$STATS/tx_packets"); I0=$(irq_sample "$IF")
+	set -- $(cpu_sample); BUSY0=$1; SOFT0=$2; TOT0=$3
+	sleep "$SECS"
+	P1=$(cat "$STATS/rx_packets"); B1=$(cat "$STATS/rx_bytes"); D1=$(cat "$STATS/rx_dropped")
+	T1=$(cat "$STATS/tx_packets"); I1=$(irq_sample "$IF")
+	set -- $(cpu_sample); BUSY1=$1; SOFT1=$2; TOT1=$3
+
+	awk -v p=$((P1 - P0)) -v b=$((B1 - B0)) -v d=$((D1 - D0)) -v t=$((T1 - T0)) -v s="$SECS" \
+	    -v irq=$((I1 - I0)) -v busy=$((BUSY1 - BUSY0)) -v soft=$((SOFT1 - SOFT0)) \
+	    -v tot=$((TOT1 - TOT0)) 'BEGIN {
+		printf "rx %.0f pps, %.2f Mbit/s, %d dropped, tx %.0f pps\n",
+			p / s, b * 8 / s / 1e6, d, t / s
+		printf "irq %.0f /s, cpu %.1f %%, softirq %.1f %%\n",
+			irq / s, tot ? busy * 100 / tot : 0, tot ? soft * 100 / tot : 0
+	}'
+}
+
+drop() {
+	IF=$1; MODE=$2; SECS=${3:-10}
+	[ -n "$IF" ] || usage
+	case "$MODE" in
+	xdp)
+		OBJ=$(dirname "$0")/xdp_drop.bpf.o
+		[ -f "$OBJ" ] || { echo "build $OBJ first, see xdp_drop.bpf.c"; exit 1; }
+		ip link set dev "$IF" xdp obj "$OBJ" sec xdp || exit 1
+		trap 'ip link set dev "$IF" xdp off' EXIT
+		;;
+	skb)
+		tc qdisc add dev "$IF" clsact || exit 1
+		trap 'tc qdisc del dev "$IF" clsact' EXIT
+		tc filter add dev "$IF" ingress matchall action drop || exit 1
+		;;
+	*) usage ;;
+	esac
+	echo "dropping on $IF through the $MODE path"
+	rx "$IF" "$SECS"
+}
+
+# value of one ethtool -S counter
+ethtool_stat() {
+	ethtool -S "$1" | awk -v name="$2:" '$1 == name { print $2; found = 1 } END { if (!found) print "" }'
+}
+
+mmio() {
+	IF=$1; SECS=${2:-10}
+	[ -n "$IF" ] || usage
+	STATS=/sys/class/net/$IF/statistics
+	[ -d "$STATS" ] || { echo "no such interface: $IF"; exit 1; }
+	[ -n "$(ethtool_stat "$IF" mmio_reads)" ] || { echo "driver built without BL702_MMIO_STATS"; exit 1; }
+
+	R0=$(ethtool_stat "$IF" mmio_reads); W0=$(ethtool_stat "$IF" mmio_writes)
+	P0=$(($(cat "$STATS/rx_packets") + $(cat "$STATS/tx_packets")))
+	sleep "$SECS"
+	R1=$(ethtool_stat "$IF" mmio_reads); W1=$(ethtool_stat "$IF" mmio_writes)
+	P1=$(($(cat "$STATS/rx_packets") + $(cat "$STATS/tx_packets")))
+
+	awk -v r=$((R1 - R0)) -v w=$((W1 - W0)) -v p=$((P1 - P0)) 'BEGIN {
+		printf "%d packets, %.2f mmio reads/pkt, %.2f mmio writes/pkt\n",
+			p, p ? r / p : 0, p ? w / p : 0
+	}'
+}
+
+xsk() {
+	IF=$1; SECS=${2:-10}
+	[ -n "$IF" ] || usage
+	BENCH=$(dirname "$0")/xsk_bench
+	[ -x "$BENCH" ] || { echo "build $BENCH first, see xsk_bench.c"; exit 1; }
+
+	"$BENCH" packet "$IF" "$SECS" || exit 1
+	"$BENCH" xsk "$IF" "$SECS"
+}
+
+cache() {
+	IF=$1; SECS=${2:-10}
+	[ -n "$IF" ] || usage
+	STATS=/sys/class/net/$IF/statistics
+	[ -d "$STATS" ] || { echo "no such interface: $IF"; exit 1; }
+	command -v perf > /dev/null || { echo "perf not found"; exit 1; }
+
+	P0=$(($(cat "$STATS/rx_packets") + $(cat "$STATS/tx_packets")))
+	OUT=$(perf stat -a -x, -e cache-references,cache-misses,L1-dcache-load-misses \
+		sleep "$SECS" 2>&1 > /dev/null)
+	P1=$(($(cat "$STATS/rx_packets") + $(cat "$STATS/tx_packets")))
+
+	echo "$OUT" | awk -F, -v p=$((P1 - P0)) 'BEGIN { printf "%d packets\n", p }
+		$1 ~ /^[0-9]+$/ { printf "%s %.2f /pkt\n", $3, p ? $1 / p : 0 }'
+}
+
+spread() {
+	IF=$1; MASK=$2
+	[ -n "$IF" ] && [ -n "$MASK" ] || usage
+	Q=/sys/class/net/$IF/queues/rx-0
+	[ -d "$Q" ] || { echo "no such interface: $IF"; exit 1; }
+
+	echo 1 > "/sys/class/net/$IF/threaded" || exit 1
+	echo "$MASK" > "$Q/rps_cpus" || exit 1
+	echo 32768 > /proc/sys/net/core/rps_sock_flow_entries
+	echo 32768 > "$Q/rps_flow_cnt"
+
+	IRQ=$(awk -v ifname="$IF" '$NF == ifname { sub(":", "", $1); print $1 }' /proc/interrupts)
+	echo "$IF: threaded NAPI, rps_cpus $MASK, irq $IRQ on harts $(cat "/proc/irq/$IRQ/smp_affinity_list" 2>/dev/null)"
+	echo "pin the napi/$IF-* thread away from those harts with taskset if the scheduler does not"
+}
+
+# pps reported by pktgen for the last gen run
+gen_pps() {
+	grep -o '[0-9]*pps' "/proc/net/pktgen/$1" | tr -d 'ps'
+}
+
+txcross() {
+	IF=$1; DST=$2; SECS=${3:-10}
+	[ -n "$IF" ] && [ -n "$DST" ] || usage
+	CB=${TX_COPYBREAK:-/sys/module/emac1/parameters/tx_copybreak}
+	[ -w "$CB" ] || { echo "cannot write $CB, set TX_COPYBREAK"; exit 1; }
+	OLD=$(cat "$CB")
+	trap 'echo "$OLD" > "$CB"' EXIT
+
+	echo "size copy_pps map_pps"
+	for SIZE in 60 128 256 384 512 768 1024 1514; do
+		echo 1524 > "$CB"; gen "$IF" "$DST" "$SIZE" "$SECS" > /dev/null; COPY=$(gen_pps "$IF")
+		echo 0 > "$CB"; gen "$IF" "$DST" "$SIZE" "$SECS" > /dev/null; MAP=$(gen_pps "$IF")
+		echo "$SIZE $COPY $MAP"
+	done
+}
+
+case "$1" in
+gen) shift; gen "$@" ;;
+rx) shift; rx "$@" ;;
+drop) shift; drop "$@" ;;
+mmio) shift; mmio "$@" ;;
+xsk) shift; xsk "$@" ;;
+cache) shift; cache "$@" ;;
+spread) shift; spread "$@" ;;
+txcross) shift; txcross "$@" ;;
+*) usage ;;
+esac
@@ -0,0 +1,78 @@
+#!/bin/sh
+# Throughput and latency of the BL702 EMAC driver on the host-side model
+# (bl702_emac_sim.c), no board needed. Runs as root on an x86 host or QEMU
+# guest with less than 4 GiB of RAM, after "make SIM=1".
+#
+#   ./sim_bench.sh [seconds]
+#
+# Loads both modules and moves the two simulated EMACs into the network
+# namespaces emac_a (10.0.0.1) and emac_b (10.0.0.2), so traffic has to cross
+# the model. For each frame size, A sends pktgen frames to B ("rx_bench.sh gen")
+# and the script prints the rates B received and A sent. Then it prints ping
+# round trip times from A to B. It exits non-zero if B received nothing, so a
+# CI job fails when the datapath is broken.
+#
+# The model copies every frame under one lock, so absolute numbers are far from
+# the board's. Compare driver builds against each other on the same host.
+
+SECS=${1:-5}
+DIR=$(cd "$(dirname "$0")" && pwd)
+SIZES="60 128 256 512 1024 1514"
+
+fail() {
+	echo "$*"
+	exit 1
+}
+
+cleanup() {
+	ip netns del emac_a 2>/dev/null
+	ip netns del emac_b 2>/dev/null
+	rmmod bl702_emac 2>/dev/null
+	rmmod bl702_emac_sim 2>/dev/null
+}
+
+# netdev registered for simulated EMAC $1
+sim_if() {
+	ls "/sys/bus/platform/devices/bl702-emac.$1/net" 2>/dev/null
+}
+
+# statistic $3 of interface $2 inside netns $1
+ns_stat() {
+	ip netns exec "$1" cat "/sys/class/net/$2/statistics/$3"
+}
+
+[ -f "$DIR/bl702_emac_sim.ko" ] && [ -f "$DIR/bl702_emac.ko" ] || fail "build with make SIM=1 first"
+cleanup
+trap cleanup EXIT
+modprobe pktgen || fail "pktgen not available"
+insmod "$DIR/bl702_emac_sim.ko" || fail "cannot load bl702_emac_sim.ko"
+insmod "$DIR/bl702_emac.ko" || fail "cannot load bl702_emac.ko"
+
+IFA=$(sim_if 0); IFB=$(sim_if 1)
+[ -n "$IFA" ] && [ -n "$IFB" ] || fail "driver did not bind to the simulated EMACs"
+MACB=$(cat "/sys/class/net/$IFB/address")
+
+ip netns add emac_a
+ip netns add emac_b
+ip link set "$IFA" netns emac_a
+ip link set "$IFB" netns emac_b
+ip -n emac_a addr add 10.0.0.1/24 dev "$IFA"
+ip -n emac_b addr add 10.0.0.2/24 dev "$IFB"
+ip -n emac_a link set "$IFA" up
+ip -n emac_b link set "$IFB" up
+sleep 1
+
+TOTAL=0
+echo "size rx_pps tx_pps"
+for SIZE in $SIZES; do
+	R0=$(ns_stat emac_b "$IFB" rx_packets); T0=$(ns_stat emac_a "$IFA" tx_packets)
+	ip netns exec emac_a "$DIR/rx_bench.sh" gen "$IFA" "$MACB" "$SIZE" "$SECS" > /dev/null
+	R1=$(ns_stat emac_b "$IFB" rx_packets); T1=$(ns_stat emac_a "$IFA" tx_packets)
+	TOTAL=$((TOTAL + R1 - R0))
+	echo "$SIZE $(((R1 - R0) / SECS)) $(((T1 - T0) / SECS))"
+done
+
+echo "latency:"
+ip netns exec emac_a ping -c 200 -i 0.01 -q 10.0.0.2 | tail -n 2
+
+[ "$TOTAL" -gt 0 ] || fail "no frames received"
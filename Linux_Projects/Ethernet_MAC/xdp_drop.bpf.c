@@ -0,0 +1,14 @@
+// SPDX-License-Identifier: GPL-2.0
+// Drops every frame at the driver, the baseline for rx_bench.sh drop xdp.
+// Build: clang -O2 -g -target bpf -c xdp_drop.bpf.c -o xdp_drop.bpf.o
+
+#include <linux/bpf.h>
+#include <bpf/bpf_helpers.h>
+
+SEC("xdp")
+int xdp_drop(struct xdp_md *ctx)
+{
+	return XDP_DROP;
+}
+
+char _license[] SEC("license") = "GPL";
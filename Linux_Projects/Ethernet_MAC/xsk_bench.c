@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: GPL-2.0
+// Receive rate of one AF_XDP socket against an AF_PACKET socket, for rx_bench.sh xsk.
+// Build: cc -O2 -o xsk_bench xsk_bench.c -lxdp -lbpf
+//
+//   ./xsk_bench xsk <ifname> [seconds] [copy]
+//       AF_XDP socket on queue 0, zero-copy unless "copy" is given. libxdp loads
+//       the program that redirects every frame into the socket.
+//   ./xsk_bench packet <ifname> [seconds]
+//       AF_PACKET socket with a TPACKET_V3 ring, the fastest way to get frames
+//       into user space through the stack.
+//
+// Both count the frames they receive and print packets/sec at the end.
+
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <xdp/xsk.h>
+
+#define NUM_FRAMES 4096
+#define FRAME_SIZE XSK_UMEM__DEFAULT_FRAME_SIZE
+#define RX_BATCH 64
+#define BLOCK_SIZE (1 << 20)
+#define BLOCK_NR 16
+
+static volatile sig_atomic_t done;
+
+static void stop(int sig)
+{
+	done = 1;
+}
+
+static void run_for(int secs)
+{
+	signal(SIGALRM, stop);
+	signal(SIGINT, stop);
+	alarm(secs);
+}
+
+static int bench_xsk(const char *ifname, int secs, int copy)
+{
+	struct xsk_socket_config cfg = {
+		.rx_size = XSK_RING_CONS__DEFAULT_NUM_DESCS,
+		.tx_size = XSK_RING_PROD__DEFAULT_NUM_DESCS,
+		.bind_flags = (copy ? XDP_COPY : XDP_ZEROCOPY) | XDP_USE_NEED_WAKEUP,
+	};
+	struct xsk_ring_prod fill;
+	struct xsk_ring_cons comp, rx;
+	struct xsk_ring_prod tx;
+	struct xsk_umem *umem;
+	struct xsk_socket *xsk;
+	unsigned long long pkts = 0;
+	unsigned int n, i;
+	__u32 idx, fidx;
+	void *buf;
+	int ret;
+
+	buf = mmap(NULL, NUM_FRAMES * FRAME_SIZE, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	ret = xsk_umem__create(&umem, buf, NUM_FRAMES * FRAME_SIZE, &fill, &comp, NULL);
+	if (ret) {
+		fprintf(stderr, "xsk_umem__create: %s\n", strerror(-ret));
+		return 1;
+	}
+	ret = xsk_socket__create(&xsk, ifname, 0, umem, &rx, &tx, &cfg);
+	if (ret) {
+		fprintf(stderr, "xsk_socket__create: %s%s\n", strerror(-ret),
+			copy ? "" : ", try copy mode");
+		return 1;
+	}
+
+	// Every frame of the UMEM starts out on the fill ring
+	n = xsk_ring_prod__reserve(&fill, XSK_RING_PROD__DEFAULT_NUM_DESCS, &fidx);
+	for (i = 0; i < n; i++)
+		*xsk_ring_prod__fill_addr(&fill, fidx++) = (__u64)i * FRAME_SIZE;
+	xsk_ring_prod__submit(&fill, n);
+
+	run_for(secs);
+	while (!done) {
+		// The driver asks for a kick once it ran out of fill ring frames
+		if (xsk_ring_prod__needs_wakeup(&fill))
+			recvfrom(xsk_socket__fd(xsk), NULL, 0, MSG_DONTWAIT, NULL, NULL);
+
+		n = xsk_ring_cons__peek(&rx, RX_BATCH, &idx);
+		if (!n)
+			continue;
+
+		// Received frames go straight back on the fill ring
+		while (xsk_ring_prod__reserve(&fill, n, &fidx) != n)
+			;
+		for (i = 0; i < n; i++)
+			*xsk_ring_prod__fill_addr(&fill, fidx++) =
+				xsk_umem__extract_addr(xsk_ring_cons__rx_desc(&rx, idx++)->addr);
+		xsk_ring_prod__submit(&fill, n);
+		xsk_ring_cons__release(&rx, n);
+		pkts += n;
+	}
+
+	printf("xsk %s: %llu packets, %.0f pps\n", copy ? "copy" : "zero-copy", pkts,
+	       (double)pkts / secs);
+	xsk_socket__delete(xsk);
+	xsk_umem__delete(umem);
+	munmap(buf, NUM_FRAMES * FRAME_SIZE);
+	return 0;
+}
+
+static int bench_packet(const char *ifname, int secs)
+{
+	struct tpacket_req3 req = {
+		.tp_block_size = BLOCK_SIZE,
+		.tp_block_nr = BLOCK_NR,
+		.tp_frame_size = 2048,
+		.tp_frame_nr = BLOCK_SIZE / 2048 * BLOCK_NR,
+		.tp_retire_blk_tov = 10,
+	};
+	struct sockaddr_ll sll = {
+		.sll_family = AF_PACKET,
+		.sll_protocol = htons(ETH_P_ALL),
+	};
+	int ver = TPACKET_V3;
+	unsigned long long pkts = 0;
+	unsigned int block = 0;
+	struct pollfd pfd;
+	uint8_t *ring;
+	int fd;
+
+	sll.sll_ifindex = if_nametoindex(ifname);
+	if (!sll.sll_ifindex) {
+		fprintf(stderr, "no such interface: %s\n", ifname);
+		return 1;
+	}
+	fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+	if (fd < 0 ||
+	    setsockopt(fd, SOL_PACKET, PACKET_VERSION, &ver, sizeof(ver)) ||
+	    setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req))) {
+		perror("AF_PACKET socket");
+		return 1;
+	}
+	ring = mmap(NULL, BLOCK_SIZE * BLOCK_NR, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ring == MAP_FAILED || bind(fd, (struct sockaddr *)&sll, sizeof(sll))) {
+		perror("AF_PACKET ring");
+		return 1;
+	}
+
+	pfd.fd = fd;
+	pfd.events = POLLIN | POLLERR;
+	run_for(secs);
+	while (!done) {
+		struct tpacket_block_desc *bd = (void *)(ring + block * BLOCK_SIZE);
+
+		if (!(bd->hdr.bh1.block_status & TP_STATUS_USER)) {
+			poll(&pfd, 1, 100);
+			continue;
+		}
+		pkts += bd->hdr.bh1.num_pkts;
+		bd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+		block = (block + 1) % BLOCK_NR;
+	}
+
+	printf("af_packet: %llu packets, %.0f pps\n", pkts, (double)pkts / secs);
+	munmap(ring, BLOCK_SIZE * BLOCK_NR);
+	close(fd);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int secs;
+
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s xsk <ifname> [seconds] [copy]\n"
+				"       %s packet <ifname> [seconds]\n", argv[0], argv[0]);
+		return 1;
+	}
+	secs = argc > 3 ? atoi(argv[3]) : 10;
+	if (secs <= 0)
+		secs = 10;
+
+	if (!strcmp(argv[1], "xsk"))
+		return bench_xsk(argv[2], secs, argc > 4 && !strcmp(argv[4], "copy"));
+	if (!strcmp(argv[1], "packet"))
+		return bench_packet(argv[2], secs);
+	fprintf(stderr, "unknown mode: %s\n", argv[1]);
+	return 1;
+}